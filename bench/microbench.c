@@ -0,0 +1,564 @@
+////////////////////////////////////////////////////////////////////////////////
+// Microbenchmarks for the hot kernels: vector and matrix math, barycentric
+// weights, triangle rasterization and texture sampling. Each kernel runs over
+// a fixed, seeded set of inputs; after a few warm-up runs it is timed over a
+// number of repetitions and the median, minimum, mean and standard deviation
+// per item are reported. Kernels named group/variant are compared with the
+// first variant of their group, which is always the one the renderer uses,
+// so SIMD or otherwise rewritten candidates can be judged side by side.
+//
+// Build with `make microbench`, then run `./microbench [FILTER] [--reps N]`
+// to run only the kernels whose name contains FILTER.
+////////////////////////////////////////////////////////////////////////////////
+
+#include "clock.h"
+#include "context.h"
+#include "matrix.h"
+#include "settings.h"
+#include "stats.h"
+#include "texture.h"
+#include "triangle.h"
+#include "vector.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define NUM_INPUTS 4096
+#define NUM_TRIANGLES 256
+#define WARMUP_RUNS 3
+#define DEFAULT_REPETITIONS 31
+#define FRAMEBUFFER_WIDTH 800
+#define FRAMEBUFFER_HEIGHT 600
+
+typedef struct kernel kernel_t;
+
+struct kernel {
+  const char *name; // group/variant
+  const char *unit; // what one item is, results are per item
+  void (*setup)(const kernel_t *kernel);
+  void (*prepare)(void); // before every repetition, not timed
+  uint64_t (*run)(const kernel_t *kernel); // returns the number of items processed
+  float (*verify)(void); // biggest difference from the renderer's own version
+  int arg0;
+  int arg1;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Inputs
+////////////////////////////////////////////////////////////////////////////////
+
+// xorshift32, so every run sees the same inputs.
+static uint32_t rng_state = 2463534242u;
+
+static uint32_t rng(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state;
+}
+
+static float random_float(float min, float max) {
+  return min + (max - min) * (rng() / 4294967296.0f);
+}
+
+static vec3_t vectors[NUM_INPUTS];
+static vec3_t results3[NUM_INPUTS];
+static vec4_t points[NUM_INPUTS];
+static vec4_t results4[NUM_INPUTS];
+static mat4_t matrices[NUM_INPUTS];
+static mat4_t results_mat[NUM_INPUTS];
+
+// Structure of arrays copy of vectors for the SIMD normalize.
+static float vectors_x[NUM_INPUTS], vectors_y[NUM_INPUTS], vectors_z[NUM_INPUTS];
+
+static volatile float sink; // keeps results alive
+
+static void setup_vectors(const kernel_t *kernel) {
+  (void)kernel;
+  rng_state = 2463534242u;
+  for (int i = 0; i < NUM_INPUTS; i++) {
+    vec3_t v = {random_float(-100, 100), random_float(-100, 100), random_float(-100, 100)};
+    vectors[i] = v;
+    vectors_x[i] = v.x;
+    vectors_y[i] = v.y;
+    vectors_z[i] = v.z;
+    vec4_t p = {v.x, v.y, v.z, 1};
+    points[i] = p;
+    for (int r = 0; r < 4; r++) {
+      for (int c = 0; c < 4; c++) {
+        matrices[i].m[r][c] = random_float(-2, 2);
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// vec3_normalize
+////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t run_normalize(const kernel_t *kernel) {
+  (void)kernel;
+  for (int i = 0; i < NUM_INPUTS; i++) {
+    results3[i] = vectors[i];
+    vec3_normalize(&results3[i]);
+  }
+  return NUM_INPUTS;
+}
+
+static void normalize_sqrtf(vec3_t *v) {
+  float inverse_length = 1.0f / sqrtf(v->x * v->x + v->y * v->y + v->z * v->z);
+  v->x *= inverse_length;
+  v->y *= inverse_length;
+  v->z *= inverse_length;
+}
+
+static uint64_t run_normalize_sqrtf(const kernel_t *kernel) {
+  (void)kernel;
+  for (int i = 0; i < NUM_INPUTS; i++) {
+    results3[i] = vectors[i];
+    normalize_sqrtf(&results3[i]);
+  }
+  return NUM_INPUTS;
+}
+
+static float verify_normalize(void) {
+  float error = 0;
+  for (int i = 0; i < NUM_INPUTS; i++) {
+    vec3_t expected = vectors[i];
+    vec3_normalize(&expected);
+    error = fmaxf(error, fabsf(results3[i].x - expected.x));
+    error = fmaxf(error, fabsf(results3[i].y - expected.y));
+    error = fmaxf(error, fabsf(results3[i].z - expected.z));
+  }
+  return error;
+}
+
+#ifdef __SSE2__
+// Four vectors at a time from the structure of arrays copy.
+static uint64_t run_normalize_sse(const kernel_t *kernel) {
+  (void)kernel;
+  for (int i = 0; i < NUM_INPUTS; i += 4) {
+    __m128 x = _mm_loadu_ps(&vectors_x[i]);
+    __m128 y = _mm_loadu_ps(&vectors_y[i]);
+    __m128 z = _mm_loadu_ps(&vectors_z[i]);
+    __m128 length_squared =
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+    __m128 inverse_length = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length_squared));
+    float out[3][4];
+    _mm_storeu_ps(out[0], _mm_mul_ps(x, inverse_length));
+    _mm_storeu_ps(out[1], _mm_mul_ps(y, inverse_length));
+    _mm_storeu_ps(out[2], _mm_mul_ps(z, inverse_length));
+    for (int j = 0; j < 4; j++) {
+      results3[i + j].x = out[0][j];
+      results3[i + j].y = out[1][j];
+      results3[i + j].z = out[2][j];
+    }
+  }
+  return NUM_INPUTS;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// mat4_mul_vec4: one matrix for all points, like a world matrix for a mesh.
+////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t run_mul_vec4(const kernel_t *kernel) {
+  (void)kernel;
+  mat4_t m = matrices[0];
+  for (int i = 0; i < NUM_INPUTS; i++) {
+    results4[i] = mat4_mul_vec4(m, points[i]);
+  }
+  return NUM_INPUTS;
+}
+
+static float verify_mul_vec4(void) {
+  float error = 0;
+  for (int i = 0; i < NUM_INPUTS; i++) {
+    vec4_t expected = mat4_mul_vec4(matrices[0], points[i]);
+    error = fmaxf(error, fabsf(results4[i].x - expected.x));
+    error = fmaxf(error, fabsf(results4[i].y - expected.y));
+    error = fmaxf(error, fabsf(results4[i].z - expected.z));
+    error = fmaxf(error, fabsf(results4[i].w - expected.w));
+  }
+  return error;
+}
+
+#ifdef __SSE2__
+// The matrix is split into columns once, then every point is four broadcasts and multiply-adds.
+static uint64_t run_mul_vec4_sse(const kernel_t *kernel) {
+  (void)kernel;
+  const mat4_t *m = &matrices[0];
+  __m128 columns[4];
+  for (int c = 0; c < 4; c++) {
+    columns[c] = _mm_setr_ps(m->m[0][c], m->m[1][c], m->m[2][c], m->m[3][c]);
+  }
+  for (int i = 0; i < NUM_INPUTS; i++) {
+    __m128 result = _mm_mul_ps(columns[0], _mm_set1_ps(points[i].x));
+    result = _mm_add_ps(result, _mm_mul_ps(columns[1], _mm_set1_ps(points[i].y)));
+    result = _mm_add_ps(result, _mm_mul_ps(columns[2], _mm_set1_ps(points[i].z)));
+    result = _mm_add_ps(result, _mm_mul_ps(columns[3], _mm_set1_ps(points[i].w)));
+    _mm_storeu_ps(&results4[i].x, result);
+  }
+  return NUM_INPUTS;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// mat4_mul_mat4
+////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t run_mul_mat4(const kernel_t *kernel) {
+  (void)kernel;
+  for (int i = 0; i < NUM_INPUTS - 1; i++) {
+    results_mat[i] = mat4_mul_mat4(matrices[i], matrices[i + 1]);
+  }
+  return NUM_INPUTS - 1;
+}
+
+static float verify_mul_mat4(void) {
+  float error = 0;
+  for (int i = 0; i < NUM_INPUTS - 1; i++) {
+    mat4_t expected = mat4_mul_mat4(matrices[i], matrices[i + 1]);
+    for (int r = 0; r < 4; r++) {
+      for (int c = 0; c < 4; c++) {
+        error = fmaxf(error, fabsf(results_mat[i].m[r][c] - expected.m[r][c]));
+      }
+    }
+  }
+  return error;
+}
+
+#ifdef __SSE2__
+// Row i of the product is the rows of m2 weighted by the elements of row i of m1.
+static uint64_t run_mul_mat4_sse(const kernel_t *kernel) {
+  (void)kernel;
+  for (int i = 0; i < NUM_INPUTS - 1; i++) {
+    const mat4_t *m1 = &matrices[i];
+    const mat4_t *m2 = &matrices[i + 1];
+    __m128 rows[4];
+    for (int r = 0; r < 4; r++) {
+      rows[r] = _mm_loadu_ps(m2->m[r]);
+    }
+    for (int r = 0; r < 4; r++) {
+      __m128 row = _mm_mul_ps(_mm_set1_ps(m1->m[r][0]), rows[0]);
+      row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(m1->m[r][1]), rows[1]));
+      row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(m1->m[r][2]), rows[2]));
+      row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(m1->m[r][3]), rows[3]));
+      _mm_storeu_ps(results_mat[i].m[r], row);
+    }
+  }
+  return NUM_INPUTS - 1;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Triangles: screen space triangles of a given size class, drawn into an
+// offscreen framebuffer. Results are per shaded pixel, except for the
+// barycentric weights which are per call.
+////////////////////////////////////////////////////////////////////////////////
+
+enum triangle_size { TRIANGLES_SMALL, TRIANGLES_LARGE, TRIANGLES_SLIVER };
+
+typedef struct {
+  vec4_t points[3];
+  tex2_t texcoords[3];
+} bench_triangle_t;
+
+static render_context_t context;
+static bench_triangle_t triangles[NUM_TRIANGLES];
+static texture_t texture;
+static color_t *texels = NULL;
+
+static void make_triangles(enum triangle_size size) {
+  rng_state = 88172645u;
+  for (int i = 0; i < NUM_TRIANGLES; i++) {
+    float x = random_float(50, FRAMEBUFFER_WIDTH - 350);
+    float y = random_float(50, FRAMEBUFFER_HEIGHT - 350);
+    float w = random_float(0.1, 1); // the same depth for the whole triangle
+    vec2_t corners[3];
+    if (size == TRIANGLES_SMALL) { // a few pixels
+      for (int j = 0; j < 3; j++) {
+        corners[j] = (vec2_t){x + random_float(0, 4), y + random_float(0, 4)};
+      }
+    } else if (size == TRIANGLES_LARGE) { // a good part of the screen
+      corners[0] = (vec2_t){x, y};
+      corners[1] = (vec2_t){x + random_float(150, 300), y + random_float(0, 50)};
+      corners[2] = (vec2_t){x + random_float(0, 50), y + random_float(150, 300)};
+    } else { // long and at most a couple of pixels thin
+      corners[0] = (vec2_t){x, y};
+      corners[1] = (vec2_t){x + random_float(200, 300), y + random_float(0, 300)};
+      corners[2] = (vec2_t){corners[1].x + random_float(1, 2), corners[1].y};
+    }
+    for (int j = 0; j < 3; j++) {
+      triangles[i].points[j] = (vec4_t){corners[j].x, corners[j].y, w, w};
+      triangles[i].texcoords[j] = (tex2_t){random_float(0, 1), random_float(0, 1)};
+    }
+  }
+}
+
+// A texture of noise, so the samples don't all come from a few cache lines.
+static void make_texture(int size, enum texture_layout layout) {
+  if (texels != NULL) {
+    free_texture(&texture);
+    free(texels);
+  }
+  texels = (color_t *)malloc(sizeof(color_t) * size * size);
+  rng_state = 1234567u;
+  for (int i = 0; i < size * size; i++) {
+    texels[i] = rng() | 0xFF000000;
+  }
+  texture_init(&texture, size, size, texels);
+  generate_mipmaps(&texture);
+  if (layout == TEXTURE_LAYOUT_TILED) {
+    texture_tile(&texture);
+  } else if (layout == TEXTURE_LAYOUT_BC1) {
+    texture_compress(&texture);
+  }
+}
+
+static void setup_triangles(const kernel_t *kernel) {
+  make_triangles(kernel->arg0);
+  make_texture(256, TEXTURE_LAYOUT_TILED);
+}
+
+static void prepare_framebuffer(void) {
+  clear_z_buffer(&context);
+  reset_render_stats(&context);
+}
+
+static uint64_t run_barycentric(const kernel_t *kernel) {
+  (void)kernel;
+  float sum = 0;
+  for (int i = 0; i < NUM_TRIANGLES; i++) {
+    vec2_t a = vec2_from_vec4(triangles[i].points[0]);
+    vec2_t b = vec2_from_vec4(triangles[i].points[1]);
+    vec2_t c = vec2_from_vec4(triangles[i].points[2]);
+    for (int j = 0; j < 16; j++) {
+      vec2_t p = {a.x + j, a.y + j};
+      sum += barycentric_weights(a, b, c, p).x;
+    }
+  }
+  sink = sum;
+  return NUM_TRIANGLES * 16;
+}
+
+static uint64_t run_filled_triangles(const kernel_t *kernel) {
+  (void)kernel;
+  for (int i = 0; i < NUM_TRIANGLES; i++) {
+    vec4_t *p = triangles[i].points;
+    draw_filled_triangle(&context, p[0].x, p[0].y, p[0].z, p[0].w, p[1].x, p[1].y, p[1].z, p[1].w,
+                         p[2].x, p[2].y, p[2].z, p[2].w, 0xFFFFFFFF);
+  }
+  return context.stats.pixels_shaded;
+}
+
+static uint64_t run_textured_triangles(const kernel_t *kernel) {
+  (void)kernel;
+  for (int i = 0; i < NUM_TRIANGLES; i++) {
+    vec4_t *p = triangles[i].points;
+    tex2_t *t = triangles[i].texcoords;
+    draw_textured_triangle(&context, p[0].x, p[0].y, p[0].z, p[0].w, t[0].u, t[0].v, p[1].x,
+                           p[1].y, p[1].z, p[1].w, t[1].u, t[1].v, p[2].x, p[2].y, p[2].z, p[2].w,
+                           t[2].u, t[2].v, &texture);
+  }
+  return context.stats.pixels_shaded;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// texture_sample at random coordinates, from the full resolution level.
+////////////////////////////////////////////////////////////////////////////////
+
+static tex2_t sample_coordinates[NUM_INPUTS];
+
+static void setup_texture_sample(const kernel_t *kernel) {
+  make_texture(kernel->arg0, kernel->arg1);
+  rng_state = 521288629u;
+  for (int i = 0; i < NUM_INPUTS; i++) {
+    sample_coordinates[i] = (tex2_t){random_float(0, 1), random_float(0, 1)};
+  }
+}
+
+static uint64_t run_texture_sample(const kernel_t *kernel) {
+  (void)kernel;
+  color_t sum = 0;
+  for (int i = 0; i < NUM_INPUTS; i++) {
+    sum += texture_sample(&texture, 0, sample_coordinates[i].u, sample_coordinates[i].v);
+  }
+  sink = (float)sum;
+  return NUM_INPUTS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The kernels, grouped by what they compute. The first variant of a group is
+// the renderer's own and the baseline of the comparison.
+////////////////////////////////////////////////////////////////////////////////
+
+#define TEXTURE_SAMPLE_KERNELS(size)                                                               \
+  {"texture_sample/" #size "/linear", "sample", setup_texture_sample, NULL, run_texture_sample,    \
+   NULL, size, TEXTURE_LAYOUT_LINEAR},                                                             \
+      {"texture_sample/" #size "/tiled", "sample", setup_texture_sample, NULL,                     \
+       run_texture_sample, NULL, size, TEXTURE_LAYOUT_TILED},                                      \
+      {"texture_sample/" #size "/bc1", "sample", setup_texture_sample, NULL, run_texture_sample,   \
+       NULL, size, TEXTURE_LAYOUT_BC1}
+
+static const kernel_t kernels[] = {
+    {"vec3_normalize/scalar", "vector", setup_vectors, NULL, run_normalize, NULL, 0, 0},
+    {"vec3_normalize/sqrtf", "vector", setup_vectors, NULL, run_normalize_sqrtf, verify_normalize,
+     0, 0},
+#ifdef __SSE2__
+    {"vec3_normalize/sse", "vector", setup_vectors, NULL, run_normalize_sse, verify_normalize, 0,
+     0},
+#endif
+    {"mat4_mul_vec4/scalar", "vector", setup_vectors, NULL, run_mul_vec4, NULL, 0, 0},
+#ifdef __SSE2__
+    {"mat4_mul_vec4/sse", "vector", setup_vectors, NULL, run_mul_vec4_sse, verify_mul_vec4, 0, 0},
+#endif
+    {"mat4_mul_mat4/scalar", "matrix", setup_vectors, NULL, run_mul_mat4, NULL, 0, 0},
+#ifdef __SSE2__
+    {"mat4_mul_mat4/sse", "matrix", setup_vectors, NULL, run_mul_mat4_sse, verify_mul_mat4, 0, 0},
+#endif
+    {"barycentric_weights/scalar", "call", setup_triangles, NULL, run_barycentric, NULL,
+     TRIANGLES_LARGE, 0},
+    {"triangles/small/filled", "pixel", setup_triangles, prepare_framebuffer, run_filled_triangles,
+     NULL, TRIANGLES_SMALL, 0},
+    {"triangles/small/textured", "pixel", setup_triangles, prepare_framebuffer,
+     run_textured_triangles, NULL, TRIANGLES_SMALL, 0},
+    {"triangles/large/filled", "pixel", setup_triangles, prepare_framebuffer, run_filled_triangles,
+     NULL, TRIANGLES_LARGE, 0},
+    {"triangles/large/textured", "pixel", setup_triangles, prepare_framebuffer,
+     run_textured_triangles, NULL, TRIANGLES_LARGE, 0},
+    {"triangles/sliver/filled", "pixel", setup_triangles, prepare_framebuffer,
+     run_filled_triangles, NULL, TRIANGLES_SLIVER, 0},
+    {"triangles/sliver/textured", "pixel", setup_triangles, prepare_framebuffer,
+     run_textured_triangles, NULL, TRIANGLES_SLIVER, 0},
+    TEXTURE_SAMPLE_KERNELS(64),
+    TEXTURE_SAMPLE_KERNELS(256),
+    TEXTURE_SAMPLE_KERNELS(1024),
+    TEXTURE_SAMPLE_KERNELS(2048),
+};
+
+#define NUM_KERNELS (int)(sizeof(kernels) / sizeof(kernels[0]))
+
+////////////////////////////////////////////////////////////////////////////////
+// Timing and reporting
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  double median, min, mean, stddev; // nanoseconds per item
+} timing_t;
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static timing_t time_kernel(const kernel_t *kernel, int repetitions) {
+  double *samples = (double *)malloc(sizeof(double) * repetitions);
+
+  for (int i = 0; i < WARMUP_RUNS; i++) {
+    if (kernel->prepare != NULL) {
+      kernel->prepare();
+    }
+    kernel->run(kernel);
+  }
+
+  for (int i = 0; i < repetitions; i++) {
+    if (kernel->prepare != NULL) {
+      kernel->prepare();
+    }
+    uint64_t start = clock_ns();
+    uint64_t items = kernel->run(kernel);
+    uint64_t end = clock_ns();
+    samples[i] = (double)(end - start) / (items > 0 ? items : 1);
+  }
+
+  timing_t timing = {0, 0, 0, 0};
+  qsort(samples, repetitions, sizeof(double), compare_doubles);
+  timing.median = samples[repetitions / 2];
+  timing.min = samples[0];
+  for (int i = 0; i < repetitions; i++) {
+    timing.mean += samples[i] / repetitions;
+  }
+  for (int i = 0; i < repetitions; i++) {
+    timing.stddev += (samples[i] - timing.mean) * (samples[i] - timing.mean) / repetitions;
+  }
+  timing.stddev = sqrt(timing.stddev);
+
+  free(samples);
+  return timing;
+}
+
+// Length of the group part of a kernel name, everything before the last '/'.
+static int group_length(const char *name) {
+  const char *slash = strrchr(name, '/');
+  return slash != NULL ? (int)(slash - name) : (int)strlen(name);
+}
+
+int main(int argc, char *argv[]) {
+  const char *filter = NULL;
+  int repetitions = DEFAULT_REPETITIONS;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+      repetitions = atoi(argv[++i]);
+    } else {
+      filter = argv[i];
+    }
+  }
+  if (repetitions < 1) {
+    repetitions = 1;
+  }
+
+  // The rasterizer draws into the buffers of a context that keeps its frames in memory.
+  render_context_init(&context, NULL, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
+  context.settings.lazy_clear = false;
+  context.settings.texture_filter = FILTER_NEAREST;
+
+  printf("%-32s %10s %10s %10s %10s %8s %10s\n", "kernel", "median", "min", "mean", "stddev",
+         "speedup", "max error");
+
+  const char *group = NULL;
+  int group_chars = 0;
+  double group_median = 0;
+
+  for (int i = 0; i < NUM_KERNELS; i++) {
+    const kernel_t *kernel = &kernels[i];
+    if (filter != NULL && strstr(kernel->name, filter) == NULL) {
+      continue;
+    }
+
+    kernel->setup(kernel);
+    timing_t timing = time_kernel(kernel, repetitions);
+
+    int chars = group_length(kernel->name);
+    if (group == NULL || chars != group_chars || strncmp(group, kernel->name, chars) != 0) {
+      group = kernel->name;
+      group_chars = chars;
+      group_median = timing.median;
+    }
+
+    char unit[16];
+    snprintf(unit, sizeof(unit), "ns/%s", kernel->unit);
+    printf("%-32s %10.3f %10.3f %10.3f %10.3f %7.2fx", kernel->name, timing.median, timing.min,
+           timing.mean, timing.stddev, group_median / timing.median);
+    if (kernel->verify != NULL) {
+      printf(" %10.2g", kernel->verify());
+    } else {
+      printf(" %10s", "-");
+    }
+    printf("  %s\n", unit);
+  }
+
+  if (texels != NULL) {
+    free_texture(&texture);
+    free(texels);
+  }
+  render_context_destroy(&context);
+  return 0;
+}
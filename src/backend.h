@@ -0,0 +1,42 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include "display.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Where finished frames go. The rasterizer only ever sees color_buffer; a
+// backend provides the output surface behind it:
+//
+//   init          create the output, possibly changing the requested size
+//                 (0 x 0 asks for the backend's natural size)
+//   lock          window sized memory the frame can be drawn into directly,
+//                 returns false when the backend can't offer that
+//   unlock        done drawing into the locked memory
+//   update        copy a window sized frame into the output instead
+//   present       show the frame that was just locked or updated
+//   set_vsync     make present wait for vertical sync, false if unsupported
+//   process_input handle pending input events for the context presenting
+//                 through the backend, if the backend has any
+//
+// Every backend drives a single output, so only one render context at a time
+// can use it.
+////////////////////////////////////////////////////////////////////////////////
+struct display_backend {
+  const char *name;
+  bool (*init)(int *width, int *height);
+  void (*destroy)(void);
+  bool (*lock)(color_t **pixels, int *stride);
+  void (*unlock)(void);
+  void (*update)(const color_t *pixels, int stride);
+  void (*present)(void);
+  bool (*set_vsync)(bool enabled);
+  void (*process_input)(render_context_t *context);
+};
+
+// An SDL window, fullscreen unless a size is requested.
+extern display_backend_t sdl_backend;
+
+// Frames stay in memory, no SDL involved. Meant for headless machines.
+extern display_backend_t offscreen_backend;
+
+#endif
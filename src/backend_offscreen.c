@@ -0,0 +1,62 @@
+#include "backend.h"
+#include "memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define OFFSCREEN_DEFAULT_WIDTH 800
+#define OFFSCREEN_DEFAULT_HEIGHT 600
+
+static color_t *frame = NULL;
+static int frame_width = 0;
+static int frame_height = 0;
+
+static bool offscreen_init(int *width, int *height) {
+  if (*width <= 0 || *height <= 0) {
+    *width = OFFSCREEN_DEFAULT_WIDTH;
+    *height = OFFSCREEN_DEFAULT_HEIGHT;
+  }
+  frame_width = *width;
+  frame_height = *height;
+  frame = (color_t *)memory_calloc(MEMORY_FRAMEBUFFER, (size_t)frame_width * frame_height,
+                                   sizeof(color_t));
+  return frame != NULL;
+}
+
+static void offscreen_destroy(void) {
+  memory_free(frame);
+  frame = NULL;
+}
+
+// The frame is plain memory, so the rasterizer can always draw straight into it.
+static bool offscreen_lock(color_t **pixels, int *stride) {
+  *pixels = frame;
+  *stride = frame_width;
+  return true;
+}
+
+static void offscreen_unlock(void) {}
+
+static void offscreen_update(const color_t *pixels, int stride) {
+  for (int y = 0; y < frame_height; y++) {
+    memcpy(&frame[frame_width * y], &pixels[stride * y], sizeof(color_t) * frame_width);
+  }
+}
+
+static void offscreen_present(void) {}
+
+static bool offscreen_set_vsync(bool enabled) { return !enabled; }
+
+static void offscreen_process_input(render_context_t *context) { (void)context; }
+
+display_backend_t offscreen_backend = {
+    .name = "offscreen",
+    .init = offscreen_init,
+    .destroy = offscreen_destroy,
+    .lock = offscreen_lock,
+    .unlock = offscreen_unlock,
+    .update = offscreen_update,
+    .present = offscreen_present,
+    .set_vsync = offscreen_set_vsync,
+    .process_input = offscreen_process_input,
+};
@@ -0,0 +1,97 @@
+#include "backend.h"
+#include "settings.h"
+#include "user_input.h"
+
+#include <SDL2/SDL.h>
+
+static SDL_Window *window = NULL;
+static SDL_Renderer *renderer = NULL;
+static SDL_Texture *color_buffer_texture = NULL;
+static bool created_with_vsync = false;
+
+static bool sdl_init(int *width, int *height) {
+  if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
+    fprintf(stderr, "Error initializing SDL.\n");
+    return false;
+  }
+
+  Uint32 flags = 0;
+  if (*width <= 0 || *height <= 0) {
+    // Fullscreen mode...
+    SDL_DisplayMode display_mode;
+    SDL_GetCurrentDisplayMode(0, &display_mode);
+    *width = display_mode.w;
+    *height = display_mode.h;
+    flags = SDL_WINDOW_BORDERLESS;
+  }
+
+  window = SDL_CreateWindow(NULL, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, *width, *height,
+                            flags);
+
+  if (!window) {
+    fprintf(stderr, "Error creating SDL window.\n");
+    return false;
+  }
+
+  created_with_vsync = pacing_mode == PACING_VSYNC;
+  renderer = SDL_CreateRenderer(window, -1, created_with_vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
+
+  if (!renderer) {
+    fprintf(stderr, "Error creating SDL renderer.\n");
+    return false;
+  }
+
+  color_buffer_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32,
+                                           SDL_TEXTUREACCESS_STREAMING, *width, *height);
+  return true;
+}
+
+static void sdl_destroy(void) {
+  SDL_DestroyTexture(color_buffer_texture);
+  SDL_DestroyRenderer(renderer);
+  SDL_DestroyWindow(window);
+  SDL_Quit();
+}
+
+static bool sdl_lock(color_t **pixels, int *stride) {
+  void *memory = NULL;
+  int pitch = 0;
+  if (SDL_LockTexture(color_buffer_texture, NULL, &memory, &pitch) != 0) {
+    return false;
+  }
+  *pixels = (color_t *)memory;
+  *stride = pitch / (int)sizeof(color_t);
+  return true;
+}
+
+static void sdl_unlock(void) { SDL_UnlockTexture(color_buffer_texture); }
+
+static void sdl_update(const color_t *pixels, int stride) {
+  SDL_UpdateTexture(color_buffer_texture, NULL, pixels, (int)(stride * sizeof(color_t)));
+}
+
+static void sdl_present(void) {
+  SDL_RenderCopy(renderer, color_buffer_texture, NULL, NULL);
+  SDL_RenderPresent(renderer);
+}
+
+// Older SDL versions can only choose vsync when the renderer is created.
+static bool sdl_set_vsync(bool enabled) {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+  return SDL_RenderSetVSync(renderer, enabled) == 0;
+#else
+  return enabled == created_with_vsync;
+#endif
+}
+
+display_backend_t sdl_backend = {
+    .name = "sdl",
+    .init = sdl_init,
+    .destroy = sdl_destroy,
+    .lock = sdl_lock,
+    .unlock = sdl_unlock,
+    .update = sdl_update,
+    .present = sdl_present,
+    .set_vsync = sdl_set_vsync,
+    .process_input = process_input,
+};
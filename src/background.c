@@ -0,0 +1,109 @@
+#include "background.h"
+#include "clear.h"
+#include "context.h"
+#include "memory.h"
+
+#include <stdlib.h>
+
+const background_t default_background = {
+    .type = BACKGROUND_GRID,
+    .color = 0x00000000,
+    .grid_color = 0xFFFFFFFF,
+    .grid_size = 50,
+    .image = NULL,
+    .image_width = 0,
+    .image_height = 0,
+};
+
+static void render_grid(const background_t *background, color_t *cache, int width,
+                        int height) {
+  for (int y = 0; y < height; y++) {
+    color_t *row = &cache[width * y];
+    // The grid lines start at grid_size, the first row and column are never part of them.
+    if (y > 0 && y % background->grid_size == 0) {
+      fill_u32(row, background->color, 1);
+      fill_u32(row + 1, background->grid_color, width - 1);
+      continue;
+    }
+    fill_u32(row, background->color, width);
+    if (y > 0) {
+      for (int x = background->grid_size; x < width; x += background->grid_size) {
+        row[x] = background->grid_color;
+      }
+    }
+  }
+}
+
+static void render_image(const background_t *background, color_t *cache, int width,
+                         int height) {
+  // Nearest neighbour stretch, with the source column of every x computed once.
+  int *source_x = (int *)memory_alloc(MEMORY_SCRATCH, sizeof(int) * width);
+  for (int x = 0; x < width; x++) {
+    source_x[x] = (int)((long)x * background->image_width / width);
+  }
+  for (int y = 0; y < height; y++) {
+    color_t *src = &background->image[background->image_width *
+                                      (int)((long)y * background->image_height / height)];
+    color_t *dst = &cache[width * y];
+    for (int x = 0; x < width; x++) {
+      dst[x] = src[source_x[x]];
+    }
+  }
+  memory_free(source_x);
+}
+
+static bool cache_is_stale(const background_cache_t *cache, const background_t *background,
+                           int width, int height) {
+  return cache->pixels == NULL || cache->width != width || cache->height != height ||
+         cache->background.type != background->type ||
+         cache->background.color != background->color ||
+         cache->background.grid_color != background->grid_color ||
+         cache->background.grid_size != background->grid_size ||
+         cache->background.image != background->image ||
+         cache->background.image_width != background->image_width ||
+         cache->background.image_height != background->image_height;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Start a frame with the background, (re)rendering the cached layer first if
+// anything it depends on changed since the last frame.
+///////////////////////////////////////////////////////////////////////////////
+void clear_to_background(render_context_t *context) {
+  const background_t *background = &context->background;
+  background_cache_t *cache = &context->background_cache;
+  int width = context->render_width;
+  int height = context->render_height;
+
+  bool has_image = background->type == BACKGROUND_IMAGE && background->image != NULL;
+  bool has_grid = background->type == BACKGROUND_GRID && background->grid_size > 0;
+  if (!has_image && !has_grid) {
+    begin_clear(context, background->color);
+    return;
+  }
+
+  if (cache_is_stale(cache, background, width, height)) {
+    if (cache->width != width || cache->height != height) {
+      memory_free(cache->pixels);
+      cache->pixels =
+          (color_t *)memory_alloc(MEMORY_FRAMEBUFFER, sizeof(color_t) * width * height);
+      cache->width = width;
+      cache->height = height;
+    }
+    if (has_grid) {
+      render_grid(background, cache->pixels, width, height);
+    } else {
+      render_image(background, cache->pixels, width, height);
+    }
+    cache->background = *background;
+  }
+
+  begin_clear_image(context, cache->pixels);
+}
+
+void free_background(render_context_t *context) {
+  background_cache_t *cache = &context->background_cache;
+  memory_free(cache->pixels);
+  cache->pixels = NULL;
+  cache->width = 0;
+  cache->height = 0;
+}
@@ -0,0 +1,39 @@
+#ifndef BACKGROUND_H
+#define BACKGROUND_H
+
+#include "display.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// The static layer behind the scene. Grids and images are rendered once into a
+// render-sized cache, which every frame is then cleared from with bulk copies
+// (see clear.h). The cache is only rebuilt when the render size or one of the
+// settings below changes. Solid backgrounds need no cache and clear with a fill.
+////////////////////////////////////////////////////////////////////////////////
+
+enum background_type { BACKGROUND_SOLID, BACKGROUND_GRID, BACKGROUND_IMAGE };
+
+typedef struct {
+  enum background_type type;
+  color_t color;      // solid color, and the color between grid lines
+  color_t grid_color; // color of the grid lines
+  int grid_size;      // distance between grid lines, in pixels
+  color_t *image;     // stretched over the whole frame, owned by the caller
+  int image_width;
+  int image_height;
+} background_t;
+
+// White grid lines on black, what a render context starts with.
+extern const background_t default_background;
+
+// What a render context's cache currently holds, to tell when it has to be rebuilt.
+typedef struct {
+  background_t background;
+  int width;
+  int height;
+  color_t *pixels;
+} background_cache_t;
+
+void clear_to_background(render_context_t *context);
+void free_background(render_context_t *context);
+
+#endif
@@ -0,0 +1,185 @@
+// getrusage() is not part of C99.
+#define _POSIX_C_SOURCE 200112L
+
+#include "bench.h"
+#include "memory.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+static const bench_scene_t default_scenes[] = {
+    {"cube", "./assets/cube.obj", "./assets/cube.png", NULL},
+    {"f22", "./assets/f22.obj", "./assets/f22.png", NULL},
+    {"drone", "./assets/drone.obj", "./assets/drone.png", NULL},
+    {"crab", "./assets/crab.obj", "./assets/crab.png", NULL},
+};
+
+#define NUM_DEFAULT_SCENES (int)(sizeof(default_scenes) / sizeof(default_scenes[0]))
+
+#define NUM_PERCENTILES 3
+static const int percentiles[NUM_PERCENTILES] = {50, 95, 99};
+
+typedef struct {
+  double mean;
+  double percentiles[NUM_PERCENTILES];
+} frame_summary_t;
+
+static int compare_floats(const void *a, const void *b) {
+  float x = *(const float *)a;
+  float y = *(const float *)b;
+  return (x > y) - (x < y);
+}
+
+// Nearest-rank percentiles, so every reported time is one that was measured.
+static frame_summary_t summarize(float *frame_times, int frames) {
+  frame_summary_t summary = {0};
+  qsort(frame_times, frames, sizeof(float), compare_floats);
+  for (int i = 0; i < frames; i++) {
+    summary.mean += frame_times[i] / frames;
+  }
+  for (int i = 0; i < NUM_PERCENTILES; i++) {
+    int rank = (int)ceil(percentiles[i] / 100.0 * frames);
+    summary.percentiles[i] = frame_times[rank > 0 ? rank - 1 : 0];
+  }
+  return summary;
+}
+
+static long peak_rss_kb(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss; // kilobytes on Linux
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Find a scene's line in a file written by bench_run() and read its frame
+// time percentiles back.
+///////////////////////////////////////////////////////////////////////////////
+static bool read_baseline(FILE *file, const char *name, double baseline[NUM_PERCENTILES]) {
+  char pattern[128];
+  snprintf(pattern, sizeof(pattern), "\"name\": \"%s\"", name);
+
+  char line[1024];
+  rewind(file);
+  while (fgets(line, 1024, file)) {
+    if (strstr(line, pattern) == NULL) {
+      continue;
+    }
+    for (int i = 0; i < NUM_PERCENTILES; i++) {
+      char key[32];
+      snprintf(key, sizeof(key), "\"ms_p%d\": ", percentiles[i]);
+      const char *value = strstr(line, key);
+      if (value == NULL || sscanf(value + strlen(key), "%lf", &baseline[i]) != 1) {
+        return false;
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+int bench_run(int frames, int width, int height, const char *output_filename,
+              const char *baseline_filename, float threshold, const synthetic_scene_t *synthetic,
+              int num_synthetic, bench_render_t render_scene) {
+  FILE *output = output_filename != NULL ? fopen(output_filename, "w") : stdout;
+  if (output == NULL) {
+    fprintf(stderr, "Error opening %s.\n", output_filename);
+    return 1;
+  }
+  FILE *baseline = NULL;
+  if (baseline_filename != NULL) {
+    baseline = fopen(baseline_filename, "r");
+    if (baseline == NULL) {
+      fprintf(stderr, "Error opening baseline %s.\n", baseline_filename);
+      if (output != stdout) {
+        fclose(output);
+      }
+      return 1;
+    }
+  }
+
+  const bench_scene_t *scenes = default_scenes;
+  int num_scenes = NUM_DEFAULT_SCENES;
+  bench_scene_t *synthetic_scenes = NULL;
+  if (num_synthetic > 0) {
+    synthetic_scenes =
+        (bench_scene_t *)memory_calloc(MEMORY_SCRATCH, num_synthetic, sizeof(bench_scene_t));
+    for (int i = 0; i < num_synthetic; i++) {
+      synthetic_scenes[i].name = synthetic[i].name;
+      synthetic_scenes[i].synthetic = &synthetic[i];
+    }
+    scenes = synthetic_scenes;
+    num_scenes = num_synthetic;
+  }
+
+  bench_result_t result;
+  result.frame_times = (float *)memory_alloc(MEMORY_SCRATCH, sizeof(float) * frames);
+
+  int exit_code = 0;
+  bool first = true;
+  fprintf(output, "{\"frames\": %d, \"width\": %d, \"height\": %d, \"scenes\": [\n", frames, width,
+          height);
+
+  for (int i = 0; i < num_scenes; i++) {
+    result.frames = frames;
+    result.seconds = 0;
+    result.geometry_ms = 0;
+    result.render_ms = 0;
+    result.faces = 0;
+    result.triangles = 0;
+    result.pixels = 0;
+    memory_reset_peaks();
+    if (!render_scene(&scenes[i], &result)) {
+      fprintf(stderr, "Skipping scene %s.\n", scenes[i].name);
+      exit_code = 1;
+      continue;
+    }
+    frame_summary_t summary = summarize(result.frame_times, frames);
+
+    fprintf(output,
+            "%s  {\"name\": \"%s\", \"faces\": %d, \"ms_mean\": %.4f, \"ms_p50\": %.4f, "
+            "\"ms_p95\": %.4f, \"ms_p99\": %.4f, \"geometry_ms_mean\": %.4f, "
+            "\"render_ms_mean\": %.4f, \"triangles_per_s\": %.0f, \"pixels_per_s\": %.0f, "
+            "\"shaded_per_pixel\": %.3f, \"memory_peak_kb\": {",
+            first ? "" : ",\n", scenes[i].name, result.faces, summary.mean,
+            summary.percentiles[0], summary.percentiles[1], summary.percentiles[2],
+            result.geometry_ms / frames, result.render_ms / frames,
+            result.triangles / result.seconds, result.pixels / result.seconds,
+            (double)result.pixels / ((double)frames * width * height));
+    for (int c = 0; c < NUM_MEMORY_CATEGORIES; c++) {
+      fprintf(output, "%s\"%s\": %lld", c > 0 ? ", " : "", memory_category_names[c],
+              (long long)(memory_usage(c).peak / 1024));
+    }
+    fprintf(output, "}}");
+    first = false;
+
+    fprintf(stderr, "%-8s p50 %8.3f ms  p95 %8.3f ms  p99 %8.3f ms", scenes[i].name,
+            summary.percentiles[0], summary.percentiles[1], summary.percentiles[2]);
+
+    double reference[NUM_PERCENTILES];
+    if (baseline != NULL && read_baseline(baseline, scenes[i].name, reference)) {
+      for (int p = 0; p < NUM_PERCENTILES; p++) {
+        double change = (summary.percentiles[p] / reference[p] - 1) * 100;
+        if (change > threshold) {
+          fprintf(stderr, "  REGRESSION p%d %+.1f%%", percentiles[p], change);
+          exit_code = exit_code == 0 ? 2 : exit_code;
+        }
+      }
+    }
+    fprintf(stderr, "\n");
+  }
+
+  fprintf(output, "\n], \"peak_rss_kb\": %ld}\n", peak_rss_kb());
+
+  memory_free(result.frame_times);
+  memory_free(synthetic_scenes);
+  if (baseline != NULL) {
+    fclose(baseline);
+  }
+  if (output != stdout) {
+    fclose(output);
+  }
+  return exit_code;
+}
@@ -0,0 +1,54 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "synthetic.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// End-to-end benchmark. Every scene is rendered offscreen for the same number
+// of frames with the same animation, settings and resolution, uncapped and
+// without frame pipelining, so two runs on the same machine are comparable.
+// Results are written as JSON, one scene per line, and can be checked against
+// a previous run's file to flag regressions.
+//
+// Generated scenes (see synthetic.h) can be benchmarked instead of the
+// built-in ones, e.g. one kind at growing triangle counts to see how the
+// geometry and render stages scale. shaded_per_pixel is the average number of
+// times each pixel was written, how much the depth test saved shows there.
+// memory_peak_kb is tracked per scene, while peak_rss_kb is the process' high
+// water mark and only reported once, after every scene.
+////////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_DEFAULT_FRAMES 300
+#define BENCH_WARMUP_FRAMES 10 // rendered first and not measured, to warm up caches and allocators
+#define BENCH_DEFAULT_THRESHOLD 5.0 // percent slower than the baseline before flagging
+
+typedef struct {
+  const char *name;
+  const char *obj_filename;
+  const char *texture_filename;
+  const synthetic_scene_t *synthetic; // generated instead of loaded when set
+} bench_scene_t;
+
+typedef struct {
+  int frames;
+  float *frame_times; // milliseconds, filled by the scene renderer
+  double seconds;
+  double geometry_ms; // building the triangle lists, over all frames
+  double render_ms;   // rasterizing and copying them out, over all frames
+  int faces;          // submitted by the scene every frame
+  uint64_t triangles; // rasterized over all frames
+  uint64_t pixels;    // shaded over all frames
+} bench_result_t;
+
+// Render frames frames of a scene, filling in the result. False if the scene can't be loaded.
+typedef bool (*bench_render_t)(const bench_scene_t *scene, bench_result_t *result);
+
+// Returns the process exit code: 0, 1 on errors, 2 when a scene regressed against the baseline.
+int bench_run(int frames, int width, int height, const char *output_filename,
+              const char *baseline_filename, float threshold, const synthetic_scene_t *synthetic,
+              int num_synthetic, bench_render_t render_scene);
+
+#endif
@@ -0,0 +1,183 @@
+#include "clear.h"
+#include "context.h"
+#include "memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// The bit pattern of a float, so depth buffers can be filled like color buffers.
+uint32_t float_bits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Fill count 32-bit words with the bit pattern value. Patterns made of one
+// repeated byte (like black) go to memset, large fills use non-temporal
+// stores when SSE2 is available, and anything else doubles a filled prefix
+// with memcpy, which is fast even in unoptimized builds. Everything goes
+// through memset/memcpy/SSE stores, so dst may just as well hold floats.
+///////////////////////////////////////////////////////////////////////////////
+void fill_u32(void *buffer, uint32_t value, size_t count) {
+  uint8_t *dst = (uint8_t *)buffer;
+  uint8_t byte = value & 0xFF;
+  if (value == byte * 0x01010101u) {
+    memset(dst, byte, count * sizeof(uint32_t));
+    return;
+  }
+
+#ifdef __SSE2__
+  if (count * sizeof(uint32_t) >= CLEAR_STREAMING_THRESHOLD) {
+    while (count > 0 && ((uintptr_t)dst & 15) != 0) {
+      memcpy(dst, &value, sizeof(value));
+      dst += sizeof(value);
+      count--;
+    }
+    __m128i v = _mm_set1_epi32((int)value);
+    for (; count >= 16; count -= 16, dst += 64) {
+      _mm_stream_si128((__m128i *)dst, v);
+      _mm_stream_si128((__m128i *)(dst + 16), v);
+      _mm_stream_si128((__m128i *)(dst + 32), v);
+      _mm_stream_si128((__m128i *)(dst + 48), v);
+    }
+    _mm_sfence();
+  }
+#endif
+
+  if (count == 0) {
+    return;
+  }
+  memcpy(dst, &value, sizeof(value));
+  size_t filled = 1;
+  while (filled < count) {
+    size_t chunk = filled < count - filled ? filled : count - filled;
+    memcpy(dst + filled * sizeof(value), dst, chunk * sizeof(value));
+    filled += chunk;
+  }
+}
+
+static void clear_tile(render_context_t *context, int tile_x, int tile_y) {
+  clear_state_t *clear = &context->clear;
+  int render_width = context->render_width;
+  int render_height = context->render_height;
+  int x0 = tile_x << CLEAR_TILE_SHIFT;
+  int y0 = tile_y << CLEAR_TILE_SHIFT;
+  int width = x0 + CLEAR_TILE_SIZE < render_width ? CLEAR_TILE_SIZE : render_width - x0;
+  int height = y0 + CLEAR_TILE_SIZE < render_height ? CLEAR_TILE_SIZE : render_height - y0;
+
+  uint32_t far_depth = float_bits(1.0);
+  for (int y = y0; y < y0 + height; y++) {
+    color_t *row = &context->color_buffer[(context->color_buffer_stride * y) + x0];
+    if (clear->image != NULL) {
+      memcpy(row, &clear->image[(render_width * y) + x0], sizeof(color_t) * width);
+    } else {
+      fill_u32(row, clear->color, width);
+    }
+    fill_u32(&context->z_buffer[(render_width * y) + x0], far_depth, width);
+  }
+  clear->tile_cleared[(tile_y * clear->tiles_x) + tile_x] = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Start a frame cleared to the given color or image (and a depth of 1.0),
+// either right away or tile by tile as the frame gets drawn.
+///////////////////////////////////////////////////////////////////////////////
+static void begin(render_context_t *context, color_t color, const color_t *image) {
+  clear_state_t *clear = &context->clear;
+  int render_width = context->render_width;
+  int render_height = context->render_height;
+  clear->color = color;
+  clear->image = image;
+
+  if (!context->settings.lazy_clear) {
+    clear->active = false;
+    if (image != NULL) {
+      for (int y = 0; y < render_height; y++) {
+        memcpy(&context->color_buffer[context->color_buffer_stride * y], &image[render_width * y],
+               sizeof(color_t) * render_width);
+      }
+    } else {
+      clear_color_buffer(context, color);
+    }
+    clear_z_buffer(context);
+    return;
+  }
+
+  int needed_x = (render_width + CLEAR_TILE_SIZE - 1) >> CLEAR_TILE_SHIFT;
+  int needed_y = (render_height + CLEAR_TILE_SIZE - 1) >> CLEAR_TILE_SHIFT;
+  if (needed_x != clear->tiles_x || needed_y != clear->tiles_y) {
+    clear->tiles_x = needed_x;
+    clear->tiles_y = needed_y;
+    memory_free(clear->tile_cleared);
+    clear->tile_cleared =
+        (uint8_t *)memory_alloc(MEMORY_FRAMEBUFFER, clear->tiles_x * clear->tiles_y);
+  }
+
+  memset(clear->tile_cleared, 0, clear->tiles_x * clear->tiles_y);
+  clear->active = true;
+}
+
+void begin_clear(render_context_t *context, color_t color) { begin(context, color, NULL); }
+
+void begin_clear_image(render_context_t *context, const color_t *image) {
+  begin(context, 0, image);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Make sure every tile overlapping the (inclusive) pixel rectangle has been
+// cleared before something draws into it.
+///////////////////////////////////////////////////////////////////////////////
+void touch_framebuffer(render_context_t *context, int x0, int y0, int x1, int y1) {
+  clear_state_t *clear = &context->clear;
+  if (!clear->active) {
+    return;
+  }
+
+  if (x0 < 0)
+    x0 = 0;
+  if (y0 < 0)
+    y0 = 0;
+  if (x1 >= context->render_width)
+    x1 = context->render_width - 1;
+  if (y1 >= context->render_height)
+    y1 = context->render_height - 1;
+
+  for (int tile_y = y0 >> CLEAR_TILE_SHIFT; tile_y <= y1 >> CLEAR_TILE_SHIFT; tile_y++) {
+    for (int tile_x = x0 >> CLEAR_TILE_SHIFT; tile_x <= x1 >> CLEAR_TILE_SHIFT; tile_x++) {
+      if (!clear->tile_cleared[(tile_y * clear->tiles_x) + tile_x]) {
+        clear_tile(context, tile_x, tile_y);
+      }
+    }
+  }
+}
+
+// Clear whatever the frame never drew into, right before it is presented.
+void finish_clear(render_context_t *context) {
+  clear_state_t *clear = &context->clear;
+  if (!clear->active) {
+    return;
+  }
+
+  for (int tile_y = 0; tile_y < clear->tiles_y; tile_y++) {
+    for (int tile_x = 0; tile_x < clear->tiles_x; tile_x++) {
+      if (!clear->tile_cleared[(tile_y * clear->tiles_x) + tile_x]) {
+        clear_tile(context, tile_x, tile_y);
+      }
+    }
+  }
+  clear->active = false;
+}
+
+void free_clear(render_context_t *context) {
+  clear_state_t *clear = &context->clear;
+  memory_free(clear->tile_cleared);
+  clear->tile_cleared = NULL;
+  clear->tiles_x = 0;
+  clear->tiles_y = 0;
+  clear->active = false;
+}
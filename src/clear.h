@@ -0,0 +1,45 @@
+#ifndef CLEAR_H
+#define CLEAR_H
+
+#include "display.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Framebuffer clears, either to a solid color or by copying a prerendered
+// frame-sized image (see background.h). Full clears use bulk fills (non-temporal stores for big
+// buffers, so clearing doesn't evict everything else from the cache).
+//
+// With the lazy_clear setting on, begin_clear() doesn't write any pixels. The screen is
+// split into tiles and a tile is only cleared the first time something draws
+// into it (every draw_* function calls touch_framebuffer() with its bounding
+// box); finish_clear() then fills the tiles nothing touched before present.
+////////////////////////////////////////////////////////////////////////////////
+
+#define CLEAR_TILE_SIZE 64
+#define CLEAR_TILE_SHIFT 6
+
+// Buffers bigger than this are cleared with non-temporal stores.
+#define CLEAR_STREAMING_THRESHOLD (8 * 1024 * 1024)
+
+// The clear of a render context's current frame.
+typedef struct {
+  bool active; // lazily clearing, some tiles may still be dirty
+  color_t color;
+  const color_t *image; // frame sized, used instead of color when set
+  uint8_t *tile_cleared;
+  int tiles_x;
+  int tiles_y;
+} clear_state_t;
+
+void fill_u32(void *dst, uint32_t value, size_t count);
+uint32_t float_bits(float value);
+
+void begin_clear(render_context_t *context, color_t color);
+void begin_clear_image(render_context_t *context, const color_t *image);
+void touch_framebuffer(render_context_t *context, int x0, int y0, int x1, int y1);
+void finish_clear(render_context_t *context);
+void free_clear(render_context_t *context);
+
+#endif
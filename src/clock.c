@@ -0,0 +1,13 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "clock.h"
+
+#include <time.h>
+
+uint64_t clock_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+double clock_ms_since(uint64_t start_ns) { return (clock_ns() - start_ns) / 1e6; }
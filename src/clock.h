@@ -0,0 +1,11 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+// Monotonic time in nanoseconds, from an arbitrary starting point. Works without SDL.
+uint64_t clock_ns(void);
+
+double clock_ms_since(uint64_t start_ns);
+
+#endif
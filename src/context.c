@@ -0,0 +1,34 @@
+#include "context.h"
+
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Open the output and set up a context with the default settings, the grid
+// background, a light shining into the screen, the camera at the origin and
+// no meshes. A NULL backend keeps the frames in memory and needs a size; with
+// a backend, 0 x 0 lets it pick (see initialize_display()).
+///////////////////////////////////////////////////////////////////////////////
+bool render_context_init(render_context_t *context, display_backend_t *backend, int width,
+                         int height) {
+  memset(context, 0, sizeof(*context));
+  context->settings = default_render_settings;
+  context->background = default_background;
+  context->light.direction = (vec3_t){0, 0, 1};
+
+  if (!initialize_display(context, backend, width, height)) {
+    return false;
+  }
+  float aspect = (float)context->window_height / (float)context->window_width;
+  context->proj_matrix = mat4_make_perspective(FIELD_OF_VIEW, aspect, NEAR_PLANE, FAR_PLANE);
+  return true;
+}
+
+// Free the scene and the framebuffers and close the output. The pipeline must be destroyed first.
+void render_context_destroy(render_context_t *context) {
+  free_meshes(context);
+  free_overdraw_buffer(context);
+  free_background(context);
+  free_clear(context);
+  free_upscaler(&context->upscaler);
+  destroy_display(context);
+}
@@ -0,0 +1,94 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include "background.h"
+#include "clear.h"
+#include "display.h"
+#include "light.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "pipeline.h"
+#include "resolution.h"
+#include "settings.h"
+#include "stats.h"
+#include "upscale.h"
+#include "vector.h"
+
+#include <stdbool.h>
+
+#define FIELD_OF_VIEW 1.0471975512 // 60 degrees, vertical
+#define NEAR_PLANE 0.1
+#define FAR_PLANE 100.0
+
+// Called by the geometry stage before every frame is projected, to move the meshes and the
+// camera. frame counts the frames built since pipeline_init(), starting at 0.
+typedef void (*animate_t)(render_context_t *context, int frame);
+
+////////////////////////////////////////////////////////////////////////////////
+// Everything one render works with: the output and framebuffers, the
+// settings, the camera and the scene, and the state every stage keeps between
+// frames. Nothing in here is shared, so any number of contexts can render at
+// the same time, each on its own thread:
+//
+//   render_context_t context;
+//   render_context_init(&context, NULL, 128, 128);
+//   load_mesh(&context, "./assets/cube.obj", "./assets/cube.png", scale, rotation, translation);
+//   pipeline_init(&context, render_geometry, count_mesh_faces(&context));
+//   render_frame(&context, pipeline_next_frame(&context));
+//   write_ppm("thumb.ppm", display_frame(&context), 128, 128, 128);
+//   pipeline_destroy(&context);
+//   render_context_destroy(&context);
+//
+// A context without a backend keeps its frames in memory, see
+// display_frame(). Backends drive a single window or image, so at most one
+// context at a time can use one. A context, and its scene, is only ever used
+// by the thread that created it and its own geometry tasks; the settings can
+// be changed between frames.
+////////////////////////////////////////////////////////////////////////////////
+struct render_context {
+  // Output, see display.h.
+  display_backend_t *backend; // NULL for frames kept in memory
+  int window_width;           // size of the output
+  int window_height;
+  int render_width; // size of the framebuffers we rasterize into, at most the output size
+  int render_height;
+  color_t *color_buffer;
+  int color_buffer_stride; // distance between rows of color_buffer, in pixels
+  float *z_buffer;
+
+  // Our own color buffer, used when the output can't be locked or when the render resolution
+  // differs from the output resolution. It is allocated at the output size, the largest render
+  // size there is.
+  color_t *color_buffer_backing;
+  bool color_buffer_locked;
+  color_t *present_buffer; // output sized target for the upscaled frame, when not locked
+  color_t *target;         // caller memory the frames end up in, without a backend
+  int target_stride;
+
+  render_settings_t settings;
+  background_t background;
+  light_t light;
+  vec3_t camera_position;
+  mat4_t proj_matrix;
+
+  mesh_t meshes[MAX_MESHES];
+  int mesh_count;
+
+  animate_t animate; // NULL leaves the scene where it is
+  const void *animate_data;
+
+  // State the stages keep between frames.
+  render_stats_t stats;
+  overdraw_t overdraw;
+  clear_state_t clear;
+  background_cache_t background_cache;
+  upscaler_t upscaler;
+  dynamic_resolution_t dynamic_resolution;
+  pipeline_t pipeline;
+};
+
+bool render_context_init(render_context_t *context, display_backend_t *backend, int width,
+                         int height);
+void render_context_destroy(render_context_t *context);
+
+#endif
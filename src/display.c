@@ -1,119 +1,251 @@
 #include "display.h"
+#include "backend.h"
+#include "clear.h"
+#include "context.h"
+#include "memory.h"
+#include "upscale.h"
+#include "video_output.h"
 
-int window_width = 800;
-int window_height = 600;
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 
-vec3_t camera_position = {.x = 0, .y = 0, .z = 0};
-
-SDL_Window *window = NULL;
-SDL_Renderer *renderer = NULL;
-SDL_Texture *color_buffer_texture = NULL;
-color_t *color_buffer = NULL;
-float *z_buffer = NULL;
-
-bool initialize_window(void) {
-  if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
-    fprintf(stderr, "Error initializing SDL.\n");
+///////////////////////////////////////////////////////////////////////////////
+// Open the output through the given backend and allocate the framebuffers. A
+// size of 0 x 0 lets the backend pick (the desktop resolution for SDL).
+// Without a backend the frames stay in memory and the size must be given.
+///////////////////////////////////////////////////////////////////////////////
+bool initialize_display(render_context_t *context, display_backend_t *backend, int width,
+                        int height) {
+  context->backend = backend;
+  if (backend != NULL ? !backend->init(&width, &height) : width <= 0 || height <= 0) {
     return false;
   }
+  context->window_width = width;
+  context->window_height = height;
+  context->render_width = width;
+  context->render_height = height;
 
-  // Fullscreen mode...
-  SDL_DisplayMode display_mode;
-  SDL_GetCurrentDisplayMode(0, &display_mode);
-  window_width = display_mode.w;
-  window_height = display_mode.h;
+  context->color_buffer_backing =
+      (color_t *)memory_alloc(MEMORY_FRAMEBUFFER, sizeof(color_t) * width * height);
+  context->color_buffer = context->color_buffer_backing;
+  context->color_buffer_stride = width;
+  context->z_buffer = (float *)memory_alloc(MEMORY_FRAMEBUFFER, sizeof(float) * width * height);
 
-  window = SDL_CreateWindow(NULL, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, window_width,
-                            window_height, SDL_WINDOW_BORDERLESS);
-
-  if (!window) {
-    fprintf(stderr, "Error creating SDL window.\n");
+  if (context->color_buffer_backing == NULL || context->z_buffer == NULL) {
+    fprintf(stderr, "Error allocating the %dx%d framebuffers.\n", width, height);
+    destroy_display(context);
+    context->backend = NULL; // closed already, should the caller destroy the context anyway
     return false;
   }
+  return true;
+}
 
-  renderer = SDL_CreateRenderer(window, -1, 0);
+void destroy_display(render_context_t *context) {
+  memory_free(context->color_buffer_backing);
+  memory_free(context->present_buffer);
+  memory_free(context->z_buffer);
+  context->color_buffer_backing = NULL;
+  context->present_buffer = NULL;
+  context->z_buffer = NULL;
+  context->color_buffer = NULL;
+  if (context->backend != NULL) {
+    context->backend->destroy();
+  }
+}
 
-  if (!renderer) {
-    fprintf(stderr, "Error creating SDL renderer.\n");
-    return false;
+// The render size for a fraction of the window size, never bigger than the window.
+void render_size_for_scale(render_context_t *context, float scale, int *width, int *height) {
+  if (scale > 1) {
+    scale = 1;
   }
+  *width = (int)lroundf(context->window_width * scale);
+  *height = (int)lroundf(context->window_height * scale);
+  *width = *width < 1 ? 1 : *width;
+  *height = *height < 1 ? 1 : *height;
+}
 
-  /*
-  There is a possibility that malloc will fail to allocate that number of bytes in memory, e.g.,
-  when the machine does not have enough free memory. If that happens, malloc will return a NULL
-  pointer. Since the main goal of this course is to learn the fundamentals of computer graphics
-  and since this is basically an academic exercise, we avoid doing exhaustive, professional checks.
-  */
-  color_buffer = (color_t *)malloc(sizeof(color_t) * window_width * window_height);
+// Change the size the next frames are rasterized at. The buffers are window sized, so this never
+// allocates.
+void set_render_size(render_context_t *context, int width, int height) {
+  context->render_width = width < context->window_width ? width : context->window_width;
+  context->render_height = height < context->window_height ? height : context->window_height;
+}
 
-  color_buffer_texture = SDL_CreateTexture(
-      renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, window_width, window_height);
+static bool render_size_is_native(const render_context_t *context) {
+  return context->render_width == context->window_width &&
+         context->render_height == context->window_height;
+}
 
-  return true;
+// Whether frames may be drawn straight into the backend's locked output. Not while recording:
+// the video output would have to read that memory back, which may be write-only and is slow.
+static bool present_zero_copy(const render_context_t *context) {
+  return context->settings.zero_copy_present && !video_output_active();
 }
 
-void destroy_window(void) {
-  SDL_DestroyRenderer(renderer);
-  SDL_DestroyWindow(window);
-  SDL_Quit();
+///////////////////////////////////////////////////////////////////////////////
+// Point color_buffer at the memory the frame will be rasterized into. With
+// zero-copy presentation at the native resolution that is the backend's
+// output itself (e.g. the locked streaming texture), whose rows may be
+// padded, so all drawing must go through color_buffer_stride. Locked memory
+// may be write-only with undefined contents, so the frame has to be cleared
+// after this call.
+///////////////////////////////////////////////////////////////////////////////
+void lock_color_buffer(render_context_t *context) {
+  display_backend_t *backend = context->backend;
+  color_t *pixels = NULL;
+  int stride = 0;
+
+  if (backend != NULL && present_zero_copy(context) && render_size_is_native(context) &&
+      backend->lock(&pixels, &stride)) {
+    context->color_buffer = pixels;
+    context->color_buffer_stride = stride;
+    context->color_buffer_locked = true;
+  } else if (backend == NULL && context->target != NULL && render_size_is_native(context)) {
+    context->color_buffer = context->target;
+    context->color_buffer_stride = context->target_stride;
+    context->color_buffer_locked = false;
+  } else {
+    context->color_buffer = context->color_buffer_backing;
+    context->color_buffer_stride = context->render_width;
+    context->color_buffer_locked = false;
+  }
 }
 
-void render_color_buffer(void) {
-  SDL_UpdateTexture(color_buffer_texture, NULL, color_buffer,
-                    (int)(window_width * sizeof(color_t)));
-  SDL_RenderCopy(renderer, color_buffer_texture, NULL, NULL);
+// Stretch the frame to the output size into present_buffer, allocated on first use.
+static void upscale_to_present_buffer(render_context_t *context) {
+  if (context->present_buffer == NULL) {
+    context->present_buffer = (color_t *)memory_alloc(
+        MEMORY_FRAMEBUFFER, sizeof(color_t) * context->window_width * context->window_height);
+  }
+  upscale(&context->upscaler, context->color_buffer, context->render_width,
+          context->render_height, context->color_buffer_stride, context->present_buffer,
+          context->window_width, context->window_height, context->window_width,
+          context->settings.upscale_filter);
 }
 
-void clear_color_buffer(color_t color) {
-  for (int y = 0; y < window_height; y++) {
-    for (int x = 0; x < window_width; x++) {
-      draw_pixel(x, y, color);
+///////////////////////////////////////////////////////////////////////////////
+// Hand the frame to the backend, ready for present_display(). Frames rendered
+// below the window resolution are stretched on the way, straight into the
+// locked output when possible. The window sized result is also what gets
+// streamed to the video output, from memory of our own since locking is off
+// while recording. Without a backend the frame is only stretched, if needed,
+// into the target or for display_frame().
+///////////////////////////////////////////////////////////////////////////////
+void render_color_buffer(render_context_t *context) {
+  display_backend_t *backend = context->backend;
+  color_t *pixels = NULL;
+  int stride = 0;
+
+  if (backend == NULL) {
+    if (render_size_is_native(context)) {
+      return;
+    }
+    if (context->target != NULL) {
+      upscale(&context->upscaler, context->color_buffer, context->render_width,
+              context->render_height, context->color_buffer_stride, context->target,
+              context->window_width, context->window_height, context->target_stride,
+              context->settings.upscale_filter);
+    } else {
+      upscale_to_present_buffer(context);
+    }
+  } else if (context->color_buffer_locked) {
+    backend->unlock();
+    context->color_buffer_locked = false;
+  } else if (render_size_is_native(context)) {
+    if (video_output_active()) {
+      video_output_frame(context->color_buffer, context->color_buffer_stride);
+    }
+    backend->update(context->color_buffer, context->color_buffer_stride);
+  } else if (present_zero_copy(context) && backend->lock(&pixels, &stride)) {
+    upscale(&context->upscaler, context->color_buffer, context->render_width,
+            context->render_height, context->color_buffer_stride, pixels, context->window_width,
+            context->window_height, stride, context->settings.upscale_filter);
+    backend->unlock();
+  } else {
+    upscale_to_present_buffer(context);
+    if (video_output_active()) {
+      video_output_frame(context->present_buffer, context->window_width);
     }
+    backend->update(context->present_buffer, context->window_width);
   }
 }
 
-void clear_z_buffer() {
-  for (int y = 0; y < window_height; y++) {
-    for (int x = 0; x < window_width; x++) {
-      z_buffer[(window_width * y) + x] = 1.0;
-    }
+// Show the frame handed over by render_color_buffer(). May block on vsync.
+void present_display(render_context_t *context) {
+  if (context->backend != NULL) {
+    context->backend->present();
   }
 }
-void draw_pixel(int x, int y, color_t color) {
-  if (x >= 0 && y >= 0 && x < window_width && y < window_height) {
-    color_buffer[(window_width * y) + x] = color;
+
+///////////////////////////////////////////////////////////////////////////////
+// The last frame of a context without a backend or target, window_width x
+// window_height pixels without padding, valid until the next frame starts.
+// Depths are in z_buffer, at the render size.
+///////////////////////////////////////////////////////////////////////////////
+const color_t *display_frame(render_context_t *context) {
+  return render_size_is_native(context) ? context->color_buffer_backing : context->present_buffer;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Have the next frames of a context without a backend end up in the caller's
+// window_width x window_height pixels, stride pixels apart from row to row.
+// At the native resolution they are rasterized straight into it, otherwise
+// stretched into it. NULL goes back to display_frame().
+///////////////////////////////////////////////////////////////////////////////
+void display_set_target(render_context_t *context, color_t *pixels, int stride) {
+  context->target = pixels;
+  context->target_stride = stride;
+}
+
+void clear_color_buffer(render_context_t *context, color_t color) {
+  int render_width = context->render_width;
+  int render_height = context->render_height;
+  if (context->color_buffer_stride == render_width) {
+    fill_u32(context->color_buffer, color, (size_t)render_width * render_height);
+    return;
+  }
+  for (int y = 0; y < render_height; y++) {
+    fill_u32(&context->color_buffer[context->color_buffer_stride * y], color, render_width);
   }
 }
 
-void draw_grid(int grid_size) {
-  for (int y = 1; y < window_height; y++) {
-    for (int x = 1; x < window_width; x++) {
-      if (x % grid_size == 0 || y % grid_size == 0) {
-        draw_pixel(x, y, 0xFFFFFFFF);
-      }
-    }
+void clear_z_buffer(render_context_t *context) {
+  fill_u32(context->z_buffer, float_bits(1.0),
+           (size_t)context->render_width * context->render_height);
+}
+void draw_pixel(render_context_t *context, int x, int y, color_t color) {
+  if (x >= 0 && y >= 0 && x < context->render_width && y < context->render_height) {
+    context->color_buffer[(context->color_buffer_stride * y) + x] = color;
   }
 }
 
-void draw_rect(int start_x, int start_y, int w, int h, color_t color) {
+void draw_rect(render_context_t *context, int start_x, int start_y, int w, int h, color_t color) {
+  touch_framebuffer(context, start_x, start_y, start_x + w - 1, start_y + h - 1);
   for (int y = 0; y < h; y++) {
     for (int x = 0; x < w; x++) {
-      draw_pixel(x + start_x, y + start_y, color);
+      draw_pixel(context, x + start_x, y + start_y, color);
     }
   }
 }
 
-void draw_circle(int center_x, int center_y, int radius, color_t color) {
+void draw_circle(render_context_t *context, int center_x, int center_y, int radius,
+                 color_t color) {
+  touch_framebuffer(context, center_x - radius, center_y - radius, center_x + radius,
+                    center_y + radius);
   for (int y = -radius; y < radius; y++) {
     for (int x = -radius; x < radius; x++) {
       if (abs((int)floor(distance(x + center_x, y + center_y, center_x, center_y))) < radius) {
-        draw_pixel(x + center_x, y + center_y, color);
+        draw_pixel(context, x + center_x, y + center_y, color);
       }
     }
   }
 }
 
-void draw_line(int x1, int y1, int x2, int y2, color_t color) {
+void draw_line(render_context_t *context, int x1, int y1, int x2, int y2, color_t color) {
+  touch_framebuffer(context, x1 < x2 ? x1 : x2, y1 < y2 ? y1 : y2, x1 > x2 ? x1 : x2,
+                    y1 > y2 ? y1 : y2);
+
   int delta_x = x2 - x1;
   int delta_y = y2 - y1;
 
@@ -126,7 +258,7 @@ void draw_line(int x1, int y1, int x2, int y2, color_t color) {
   float current_y = y1;
 
   for (int i = 0; i <= side_length; i++) {
-    draw_pixel(round(current_x), round(current_y), color);
+    draw_pixel(context, round(current_x), round(current_y), color);
     current_x += x_inc;
     current_y += y_inc;
   }
@@ -4,37 +4,46 @@
 #include "utils.h"
 #include "vector.h"
 
-#include <SDL2/SDL.h>
 #include <stdbool.h>
 #include <stdint.h>
 
 typedef uint32_t color_t;
 
-#define FPS 60
-#define FRAME_TARGET_TIME (1000 / FPS)
-
-extern int window_width;
-extern int window_height;
-
-extern vec3_t camera_position;
+typedef struct display_backend display_backend_t;
 
-extern SDL_Window *window;
-extern SDL_Renderer *renderer;
-extern SDL_Texture *color_buffer_texture;
-extern color_t *color_buffer;
-extern float *z_buffer;
+// Everything one render works with, see context.h.
+typedef struct render_context render_context_t;
 
-bool initialize_window(void);
-void destroy_window(void);
-
-void render_color_buffer(void);
-void clear_color_buffer(color_t color);
-void clear_z_buffer(void);
+#define FPS 60
 
-void draw_pixel(int x, int y, color_t color);
-void draw_grid(int grid_size);
-void draw_rect(int start_x, int start_y, int w, int h, color_t color);
-void draw_circle(int center_x, int center_y, int radius, color_t color);
-void draw_line(int x1, int y1, int x2, int y2, color_t color);
+////////////////////////////////////////////////////////////////////////////////
+// The framebuffers of a render context and the output they end up in. The
+// output is window_width x window_height: the backend's window or offscreen
+// image, or, for a context without a backend, the frame display_frame()
+// returns or the caller's memory given to display_set_target(). Frames are
+// rasterized at render_width x render_height, at most the output size, and
+// stretched to it when handed over.
+////////////////////////////////////////////////////////////////////////////////
+
+bool initialize_display(render_context_t *context, display_backend_t *backend, int width,
+                        int height);
+void destroy_display(render_context_t *context);
+
+void render_size_for_scale(render_context_t *context, float scale, int *width, int *height);
+void set_render_size(render_context_t *context, int width, int height);
+
+void lock_color_buffer(render_context_t *context);
+void render_color_buffer(render_context_t *context);
+void present_display(render_context_t *context);
+const color_t *display_frame(render_context_t *context);
+void display_set_target(render_context_t *context, color_t *pixels, int stride);
+void clear_color_buffer(render_context_t *context, color_t color);
+void clear_z_buffer(render_context_t *context);
+
+void draw_pixel(render_context_t *context, int x, int y, color_t color);
+void draw_rect(render_context_t *context, int start_x, int start_y, int w, int h, color_t color);
+void draw_circle(render_context_t *context, int center_x, int center_y, int radius,
+                 color_t color);
+void draw_line(render_context_t *context, int x1, int y1, int x2, int y2, color_t color);
 
 #endif
@@ -0,0 +1,181 @@
+#include "golden.h"
+#include "image.h"
+#include "memory.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define GOLDEN_PATH_LENGTH 512
+
+static const golden_case_t cases[] = {
+    {"cube_textured", "./assets/cube.obj", "./assets/cube.png", 320, 240, RENDER_TEXTURED,
+     FILTER_MIPMAP, TEXTURE_LAYOUT_TILED, 0.6},
+    {"cube_fill_wire", "./assets/cube.obj", "./assets/cube.png", 320, 240,
+     RENDER_FILL_TRIANGLE_WIRE, FILTER_MIPMAP, TEXTURE_LAYOUT_TILED, 0.6},
+    {"f22_nearest_linear", "./assets/f22.obj", "./assets/f22.png", 800, 600, RENDER_TEXTURED,
+     FILTER_NEAREST, TEXTURE_LAYOUT_LINEAR, 2.2},
+    {"drone_trilinear_bc1", "./assets/drone.obj", "./assets/drone.png", 640, 480, RENDER_TEXTURED,
+     FILTER_TRILINEAR, TEXTURE_LAYOUT_BC1, 1.0},
+    {"crab_wire_vertex", "./assets/crab.obj", "./assets/crab.png", 320, 240, RENDER_WIRE_VERTEX,
+     FILTER_MIPMAP, TEXTURE_LAYOUT_TILED, 4.0},
+};
+
+#define NUM_CASES (int)(sizeof(cases) / sizeof(cases[0]))
+
+// FNV-1a, to tell at a glance in logs whether two runs produced the same frame.
+static uint64_t hash_bytes(const void *data, size_t size) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+static uint16_t quantize_depth(float depth) {
+  if (!(depth > 0)) {
+    return 0;
+  }
+  return depth >= 1 ? 65535 : (uint16_t)lroundf(depth * 65535);
+}
+
+static int channel_difference(int a, int b) { return a > b ? a - b : b - a; }
+
+static bool color_matches(color_t actual, color_t expected, int tolerance) {
+  return channel_difference(color_red(actual), color_red(expected)) <= tolerance &&
+         channel_difference(color_green(actual), color_green(expected)) <= tolerance &&
+         channel_difference(color_blue(actual), color_blue(expected)) <= tolerance;
+}
+
+static color_t gray(color_t c) {
+  int luma = (color_red(c) * 77 + color_green(c) * 150 + color_blue(c) * 29) >> 9; // dimmed
+  return 0xFF000000 | (luma << 16) | (luma << 8) | luma;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Compare a rendered case with its references, writing the actual and diff
+// images when it fails. Returns the exit code for this case.
+///////////////////////////////////////////////////////////////////////////////
+static int check_case(const golden_case_t *golden_case, const char *directory,
+                      const color_t *pixels, const uint16_t *depth, int tolerance,
+                      float depth_tolerance) {
+  int width = golden_case->width;
+  int height = golden_case->height;
+  char path[GOLDEN_PATH_LENGTH];
+
+  int color_width = 0, color_height = 0, depth_width = 0, depth_height = 0;
+  snprintf(path, sizeof(path), "%s/%s.ppm", directory, golden_case->name);
+  color_t *expected_pixels = read_ppm(path, &color_width, &color_height);
+  snprintf(path, sizeof(path), "%s/%s.depth.pgm", directory, golden_case->name);
+  uint16_t *expected_depth = read_pgm16(path, &depth_width, &depth_height);
+
+  if (expected_pixels == NULL || expected_depth == NULL) {
+    fprintf(stderr, "missing references in %s, create them with --golden-update\n", directory);
+    memory_free(expected_pixels);
+    memory_free(expected_depth);
+    return 1;
+  }
+  if (color_width != width || color_height != height || depth_width != width ||
+      depth_height != height) {
+    fprintf(stderr, "references are %dx%d, the case renders %dx%d\n", color_width, color_height,
+            width, height);
+    memory_free(expected_pixels);
+    memory_free(expected_depth);
+    return 2;
+  }
+
+  int max_depth_difference = (int)(depth_tolerance * 65535);
+  int color_failures = 0;
+  int depth_failures = 0;
+  int worst_channel = 0;
+  color_t *diff = (color_t *)memory_alloc(MEMORY_SCRATCH, sizeof(color_t) * width * height);
+
+  for (int i = 0; i < width * height; i++) {
+    bool color_ok = color_matches(pixels[i], expected_pixels[i], tolerance);
+    bool depth_ok = abs(depth[i] - expected_depth[i]) <= max_depth_difference;
+    color_failures += !color_ok;
+    depth_failures += !depth_ok;
+    diff[i] = !color_ok ? 0xFF0000FF : (!depth_ok ? 0xFFFF0000 : gray(pixels[i]));
+
+    int channels[3] = {
+        channel_difference(color_red(pixels[i]), color_red(expected_pixels[i])),
+        channel_difference(color_green(pixels[i]), color_green(expected_pixels[i])),
+        channel_difference(color_blue(pixels[i]), color_blue(expected_pixels[i])),
+    };
+    for (int c = 0; c < 3; c++) {
+      worst_channel = channels[c] > worst_channel ? channels[c] : worst_channel;
+    }
+  }
+
+  int exit_code = 0;
+  if (color_failures > 0 || depth_failures > 0) {
+    fprintf(stderr, "FAILED, %d pixels differ in color (worst channel off by %d), %d in depth",
+            color_failures, worst_channel, depth_failures);
+    snprintf(path, sizeof(path), "%s/%s.actual.ppm", directory, golden_case->name);
+    write_ppm(path, pixels, width, height, width);
+    snprintf(path, sizeof(path), "%s/%s.diff.ppm", directory, golden_case->name);
+    write_ppm(path, diff, width, height, width);
+    fprintf(stderr, ", see %s\n", path);
+    exit_code = 2;
+  } else {
+    fprintf(stderr, "ok\n");
+  }
+
+  memory_free(diff);
+  memory_free(expected_pixels);
+  memory_free(expected_depth);
+  return exit_code;
+}
+
+int golden_run(const char *directory, bool update, int tolerance, float depth_tolerance,
+               golden_render_t render_case) {
+  int exit_code = 0;
+
+  for (int i = 0; i < NUM_CASES; i++) {
+    const golden_case_t *golden_case = &cases[i];
+    int count = golden_case->width * golden_case->height;
+    color_t *pixels = (color_t *)memory_alloc(MEMORY_SCRATCH, sizeof(color_t) * count);
+    float *depth = (float *)memory_alloc(MEMORY_SCRATCH, sizeof(float) * count);
+    uint16_t *quantized_depth =
+        (uint16_t *)memory_alloc(MEMORY_SCRATCH, sizeof(uint16_t) * count);
+
+    int case_exit_code = 0;
+    if (render_case(golden_case, pixels, depth)) {
+      for (int p = 0; p < count; p++) {
+        pixels[p] |= 0xFF000000; // PPM has no alpha
+        quantized_depth[p] = quantize_depth(depth[p]);
+      }
+      fprintf(stderr, "%-20s color %016llx depth %016llx  ", golden_case->name,
+              (unsigned long long)hash_bytes(pixels, sizeof(color_t) * count),
+              (unsigned long long)hash_bytes(quantized_depth, sizeof(uint16_t) * count));
+
+      if (update) {
+        char path[GOLDEN_PATH_LENGTH];
+        snprintf(path, sizeof(path), "%s/%s.ppm", directory, golden_case->name);
+        bool ok = write_ppm(path, pixels, golden_case->width, golden_case->height,
+                            golden_case->width);
+        snprintf(path, sizeof(path), "%s/%s.depth.pgm", directory, golden_case->name);
+        ok = ok && write_pgm16(path, quantized_depth, golden_case->width, golden_case->height);
+        fprintf(stderr, "%s\n", ok ? "updated" : "FAILED to write");
+        case_exit_code = ok ? 0 : 1;
+      } else {
+        case_exit_code = check_case(golden_case, directory, pixels, quantized_depth, tolerance,
+                                    depth_tolerance);
+      }
+    } else {
+      fprintf(stderr, "%s: can't load the scene\n", golden_case->name);
+      case_exit_code = 1;
+    }
+
+    // Errors win over failures, there is no point comparing against missing references.
+    if (case_exit_code == 1 || (case_exit_code == 2 && exit_code == 0)) {
+      exit_code = case_exit_code;
+    }
+    memory_free(pixels);
+    memory_free(depth);
+    memory_free(quantized_depth);
+  }
+  return exit_code;
+}
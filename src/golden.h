@@ -0,0 +1,49 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#include "display.h"
+#include "settings.h"
+
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Golden image checks. Every case renders one frame of a scene offscreen at a
+// fixed resolution, pose and settings, and compares the color buffer and the
+// depth buffer with reference images stored in a directory:
+//
+//   NAME.ppm          expected colors
+//   NAME.depth.pgm    expected depths, 0..1 scaled to 16 bits
+//
+// A pixel fails when a color channel is further than the color tolerance from
+// the reference, or its depth further than the depth tolerance. For a failing
+// case the frame is written next to the references as NAME.actual.ppm, along
+// with NAME.diff.ppm: the frame in gray, with pixels whose color failed in red
+// and pixels where only the depth failed in blue.
+//
+// Updating writes the current frames as the new references instead.
+////////////////////////////////////////////////////////////////////////////////
+
+#define GOLDEN_DEFAULT_TOLERANCE 0          // per color channel, out of 255
+#define GOLDEN_DEFAULT_DEPTH_TOLERANCE 1e-4 // z-buffer values are 0..1
+
+typedef struct {
+  const char *name;
+  const char *obj_filename;
+  const char *texture_filename;
+  int width;
+  int height;
+  enum render_method render_method;
+  enum texture_filter texture_filter;
+  enum texture_layout texture_layout;
+  float rotation_y; // radians
+} golden_case_t;
+
+// Render a case into pixels and depth (width * height of each, tightly packed). False if the
+// scene can't be loaded.
+typedef bool (*golden_render_t)(const golden_case_t *golden_case, color_t *pixels, float *depth);
+
+// Returns the process exit code: 0, 1 on errors (e.g. missing references), 2 when a case failed.
+int golden_run(const char *directory, bool update, int tolerance, float depth_tolerance,
+               golden_render_t render_case);
+
+#endif
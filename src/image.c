@@ -0,0 +1,124 @@
+#include "image.h"
+#include "memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PPM_HEADER_MAX 32
+
+size_t ppm_size(int width, int height) { return PPM_HEADER_MAX + (size_t)width * height * 3; }
+
+// Returns the number of bytes written to out, which must hold ppm_size() bytes.
+size_t encode_ppm(uint8_t *out, const color_t *pixels, int width, int height, int stride) {
+  uint8_t *start = out;
+  out += sprintf((char *)out, "P6\n%d %d\n255\n", width, height);
+  for (int y = 0; y < height; y++) {
+    const color_t *row = &pixels[stride * y];
+    for (int x = 0; x < width; x++) {
+      *out++ = color_red(row[x]);
+      *out++ = color_green(row[x]);
+      *out++ = color_blue(row[x]);
+    }
+  }
+  return out - start;
+}
+
+bool write_ppm(const char *filename, const color_t *pixels, int width, int height, int stride) {
+  FILE *file = fopen(filename, "wb");
+  if (file == NULL) {
+    fprintf(stderr, "Error opening %s.\n", filename);
+    return false;
+  }
+  uint8_t *data = (uint8_t *)memory_alloc(MEMORY_SCRATCH, ppm_size(width, height));
+  size_t size = encode_ppm(data, pixels, width, height, stride);
+  bool ok = fwrite(data, 1, size, file) == size;
+  ok = fclose(file) == 0 && ok;
+  memory_free(data);
+  return ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Read the header of a binary PNM file of the given type ("P6" or "P5"),
+// leaving the file at the first byte of pixel data. Comments aren't
+// supported, only the files written here are read back.
+///////////////////////////////////////////////////////////////////////////////
+static FILE *open_pnm(const char *filename, const char *magic, int max_value, int *width,
+                      int *height) {
+  FILE *file = fopen(filename, "rb");
+  if (file == NULL) {
+    return NULL;
+  }
+  char type[3] = {0};
+  int max = 0;
+  if (fscanf(file, "%2s %d %d %d", type, width, height, &max) != 4 || strcmp(type, magic) != 0 ||
+      max != max_value || *width <= 0 || *height <= 0 || fgetc(file) == EOF) {
+    fprintf(stderr, "%s is not a %s image with a maximum of %d.\n", filename, magic, max_value);
+    fclose(file);
+    return NULL;
+  }
+  return file;
+}
+
+// Returns the pixels (opaque, width * height of them) to memory_free(), or NULL.
+color_t *read_ppm(const char *filename, int *width, int *height) {
+  FILE *file = open_pnm(filename, "P6", 255, width, height);
+  if (file == NULL) {
+    return NULL;
+  }
+  size_t count = (size_t)*width * *height;
+  uint8_t *data = (uint8_t *)memory_alloc(MEMORY_SCRATCH, count * 3);
+  color_t *pixels = NULL;
+  if (fread(data, 3, count, file) == count) {
+    pixels = (color_t *)memory_alloc(MEMORY_SCRATCH, sizeof(color_t) * count);
+    for (size_t i = 0; i < count; i++) {
+      pixels[i] = 0xFF000000 | (data[i * 3 + 2] << 16) | (data[i * 3 + 1] << 8) | data[i * 3];
+    }
+  } else {
+    fprintf(stderr, "%s is truncated.\n", filename);
+  }
+  memory_free(data);
+  fclose(file);
+  return pixels;
+}
+
+// PGM stores 16-bit values big-endian.
+bool write_pgm16(const char *filename, const uint16_t *values, int width, int height) {
+  FILE *file = fopen(filename, "wb");
+  if (file == NULL) {
+    fprintf(stderr, "Error opening %s.\n", filename);
+    return false;
+  }
+  size_t count = (size_t)width * height;
+  uint8_t *data = (uint8_t *)memory_alloc(MEMORY_SCRATCH, count * 2);
+  for (size_t i = 0; i < count; i++) {
+    data[i * 2] = values[i] >> 8;
+    data[i * 2 + 1] = values[i] & 0xFF;
+  }
+  bool ok = fprintf(file, "P5\n%d %d\n65535\n", width, height) > 0;
+  ok = ok && fwrite(data, 2, count, file) == count;
+  ok = fclose(file) == 0 && ok;
+  memory_free(data);
+  return ok;
+}
+
+uint16_t *read_pgm16(const char *filename, int *width, int *height) {
+  FILE *file = open_pnm(filename, "P5", 65535, width, height);
+  if (file == NULL) {
+    return NULL;
+  }
+  size_t count = (size_t)*width * *height;
+  uint8_t *data = (uint8_t *)memory_alloc(MEMORY_SCRATCH, count * 2);
+  uint16_t *values = NULL;
+  if (fread(data, 2, count, file) == count) {
+    values = (uint16_t *)memory_alloc(MEMORY_SCRATCH, sizeof(uint16_t) * count);
+    for (size_t i = 0; i < count; i++) {
+      values[i] = (data[i * 2] << 8) | data[i * 2 + 1];
+    }
+  } else {
+    fprintf(stderr, "%s is truncated.\n", filename);
+  }
+  memory_free(data);
+  fclose(file);
+  return values;
+}
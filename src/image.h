@@ -0,0 +1,25 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "display.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// color_t is RGBA32, i.e. 0xAABBGGRR on little-endian machines.
+static inline int color_red(color_t c) { return c & 0xFF; }
+static inline int color_green(color_t c) { return (c >> 8) & 0xFF; }
+static inline int color_blue(color_t c) { return (c >> 16) & 0xFF; }
+
+// Size of a binary PPM (P6) image, header included.
+size_t ppm_size(int width, int height);
+size_t encode_ppm(uint8_t *out, const color_t *pixels, int width, int height, int stride);
+bool write_ppm(const char *filename, const color_t *pixels, int width, int height, int stride);
+color_t *read_ppm(const char *filename, int *width, int *height);
+
+// 16-bit grayscale binary PGM (P5), e.g. for depth buffers.
+bool write_pgm16(const char *filename, const uint16_t *values, int width, int height);
+uint16_t *read_pgm16(const char *filename, int *width, int *height);
+
+#endif
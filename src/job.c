@@ -0,0 +1,243 @@
+#include "job.h"
+#include "context.h"
+#include "memory.h"
+#include "scheduler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+  task_t task;
+  const job_t *job;
+  job_shard_t render_shard;
+  int first;
+  int last;
+  bool ok;
+} shard_t;
+
+static bool add_key(keyframe_t *keys, int *num_keys, keyframe_t key) {
+  if (*num_keys == MAX_KEYFRAMES) {
+    return false;
+  }
+  // Keep the keys sorted by frame, files usually list them in order already.
+  int i = *num_keys;
+  while (i > 0 && keys[i - 1].frame > key.frame) {
+    keys[i] = keys[i - 1];
+    i--;
+  }
+  keys[i] = key;
+  *num_keys += 1;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Turn an output pattern from a job file into a safe printf format in place:
+// it must have exactly one frame number conversion, %d or %0Nd, and every
+// other % is escaped so the file can never make printf read an argument that
+// isn't there. False when the pattern has no single frame number or doesn't
+// fit once escaped.
+///////////////////////////////////////////////////////////////////////////////
+static bool make_output_format(char *pattern, size_t size) {
+  char format[JOB_PATH_LENGTH * 2];
+  size_t length = 0;
+  int conversions = 0;
+  for (const char *c = pattern; *c != '\0'; c++) {
+    const char *end = c + 1;
+    if (*c == '%' && *end == '0') {
+      end++;
+      while (*end >= '0' && *end <= '9' && end - c < 5) {
+        end++;
+      }
+    }
+    size_t run = 1;
+    if (*c == '%' && *end == 'd') {
+      conversions++;
+      run = end + 1 - c;
+    } else if (*c == '%') {
+      format[length++] = '%'; // escape it, the copy below adds the second one
+    }
+    memcpy(&format[length], c, run);
+    length += run;
+    c += run - 1;
+  }
+  format[length] = '\0';
+  if (conversions != 1 || length >= size) {
+    return false;
+  }
+  memcpy(pattern, format, length + 1);
+  return true;
+}
+
+bool job_load(job_t *job, const char *filename) {
+  FILE *file = fopen(filename, "r");
+  if (file == NULL) {
+    fprintf(stderr, "Error opening job %s.\n", filename);
+    return false;
+  }
+
+  memset(job, 0, sizeof(*job));
+  job->width = 256;
+  job->height = 256;
+  strcpy(job->output, "frame_%04d.ppm");
+
+  char line[1024];
+  int line_number = 0;
+  bool ok = true;
+
+  while (ok && fgets(line, 1024, file)) {
+    line_number++;
+    char word[16] = "";
+    if (sscanf(line, "%15s", word) != 1 || word[0] == '#') {
+      continue;
+    }
+
+    keyframe_t key = {.scale = {1.0, 1.0, 1.0}};
+    job_mesh_t *mesh = job->num_meshes > 0 ? &job->meshes[job->num_meshes - 1] : NULL;
+
+    if (strcmp(word, "size") == 0) {
+      ok = sscanf(line, "size %d %d", &job->width, &job->height) == 2 && job->width > 0 &&
+           job->height > 0;
+    } else if (strcmp(word, "frames") == 0) {
+      ok = sscanf(line, "frames %d %d", &job->first_frame, &job->last_frame) == 2 &&
+           job->first_frame <= job->last_frame;
+    } else if (strcmp(word, "shards") == 0) {
+      ok = sscanf(line, "shards %d", &job->shards) == 1;
+    } else if (strcmp(word, "output") == 0) {
+      ok = sscanf(line, "output %255s", job->output) == 1 &&
+           make_output_format(job->output, sizeof(job->output));
+    } else if (strcmp(word, "mesh") == 0) {
+      ok = job->num_meshes < MAX_MESHES;
+      if (ok) {
+        mesh = &job->meshes[job->num_meshes++];
+        ok = sscanf(line, "mesh %255s %255s", mesh->obj_filename, mesh->texture_filename) == 2;
+      }
+    } else if (strcmp(word, "key") == 0) {
+      int count = sscanf(line, "key %d %f %f %f %f %f %f %f %f %f", &key.frame, &key.rotation.x,
+                         &key.rotation.y, &key.rotation.z, &key.translation.x,
+                         &key.translation.y, &key.translation.z, &key.scale.x, &key.scale.y,
+                         &key.scale.z);
+      ok = mesh != NULL && (count == 7 || count == 10) &&
+           add_key(mesh->keys, &mesh->num_keys, key);
+    } else if (strcmp(word, "camera") == 0) {
+      ok = sscanf(line, "camera %d %f %f %f", &key.frame, &key.translation.x, &key.translation.y,
+                  &key.translation.z) == 4 &&
+           add_key(job->camera, &job->num_camera_keys, key);
+    } else {
+      ok = false;
+    }
+  }
+  fclose(file);
+
+  if (!ok) {
+    fprintf(stderr, "%s:%d: invalid job line: %s", filename, line_number, line);
+    return false;
+  }
+  if (job->num_meshes == 0) {
+    fprintf(stderr, "%s: the job has no meshes.\n", filename);
+    return false;
+  }
+  return true;
+}
+
+bool job_load_meshes(render_context_t *context, const job_t *job) {
+  vec3_t zero = {0, 0, 0};
+  vec3_t one = {1.0, 1.0, 1.0};
+  for (int i = 0; i < job->num_meshes; i++) {
+    if (!load_mesh(context, job->meshes[i].obj_filename, job->meshes[i].texture_filename, one, zero,
+                   zero)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static vec3_t vec3_lerp(vec3_t a, vec3_t b, float t) {
+  vec3_t result = {
+      .x = a.x + (b.x - a.x) * t,
+      .y = a.y + (b.y - a.y) * t,
+      .z = a.z + (b.z - a.z) * t,
+  };
+  return result;
+}
+
+static keyframe_t interpolate(const keyframe_t *keys, int num_keys, int frame) {
+  if (num_keys == 0) {
+    keyframe_t identity = {.frame = frame, .scale = {1.0, 1.0, 1.0}};
+    return identity;
+  }
+  if (frame <= keys[0].frame) {
+    return keys[0];
+  }
+  for (int i = 1; i < num_keys; i++) {
+    if (frame < keys[i].frame) {
+      const keyframe_t *a = &keys[i - 1];
+      const keyframe_t *b = &keys[i];
+      float t = (float)(frame - a->frame) / (b->frame - a->frame);
+      keyframe_t key = {
+          .frame = frame,
+          .rotation = vec3_lerp(a->rotation, b->rotation, t),
+          .translation = vec3_lerp(a->translation, b->translation, t),
+          .scale = vec3_lerp(a->scale, b->scale, t),
+      };
+      return key;
+    }
+  }
+  return keys[num_keys - 1];
+}
+
+// Move the loaded meshes and the camera to where the job has them at the given frame.
+void job_pose(render_context_t *context, const job_t *job, int frame) {
+  for (int i = 0; i < job->num_meshes && i < context->mesh_count; i++) {
+    keyframe_t key = interpolate(job->meshes[i].keys, job->meshes[i].num_keys, frame);
+    context->meshes[i].rotation = key.rotation;
+    context->meshes[i].translation = key.translation;
+    context->meshes[i].scale = key.scale;
+  }
+  context->camera_position = interpolate(job->camera, job->num_camera_keys, frame).translation;
+}
+
+static void run_shard(void *data) {
+  shard_t *shard = (shard_t *)data;
+  shard->ok = shard->render_shard(shard->job, shard->first, shard->last);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Split the frame range into contiguous shards and render each one as a task
+// on the scheduler's threads. Every shard renders into its own context and
+// loads its own copy of the assets, so the shards share nothing but the
+// process. A single shard runs on the calling thread.
+///////////////////////////////////////////////////////////////////////////////
+bool job_run(const job_t *job, int shards, job_shard_t render_shard) {
+  int num_frames = job->last_frame - job->first_frame + 1;
+  if (shards <= 0) {
+    shards = job->shards;
+  }
+  if (shards <= 0) {
+    shards = scheduler_num_threads();
+  }
+  if (shards > num_frames) {
+    shards = num_frames;
+  }
+  if (shards <= 1) {
+    return render_shard(job, job->first_frame, job->last_frame);
+  }
+
+  shard_t *shard_list = (shard_t *)memory_calloc(MEMORY_SCRATCH, shards, sizeof(shard_t));
+  task_group_t group = {0};
+  for (int i = 0; i < shards; i++) {
+    shard_list[i].job = job;
+    shard_list[i].render_shard = render_shard;
+    shard_list[i].first = job->first_frame + (int)((long)num_frames * i / shards);
+    shard_list[i].last = job->first_frame + (int)((long)num_frames * (i + 1) / shards) - 1;
+    task_init(&shard_list[i].task, run_shard, &shard_list[i], &group);
+    task_submit(&shard_list[i].task);
+  }
+  task_wait(&group);
+
+  bool ok = true;
+  for (int i = 0; i < shards; i++) {
+    ok = ok && shard_list[i].ok;
+  }
+  memory_free(shard_list);
+  return ok;
+}
@@ -0,0 +1,64 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include "mesh.h"
+#include "vector.h"
+
+#include <stdbool.h>
+
+#define MAX_KEYFRAMES 64
+#define JOB_PATH_LENGTH 256
+
+////////////////////////////////////////////////////////////////////////////////
+// A batch render job, read from a text file with one directive per line:
+//
+//   size W H                      output resolution
+//   frames FIRST LAST             inclusive frame range to render
+//   shards N                      pieces the frames are split into, rendered in
+//                                 parallel (default: one per thread)
+//   output PATTERN                file name with the frame number at its one
+//                                 %d or %0Nd, e.g. out/thumb_%04d.ppm
+//   mesh OBJ TEXTURE              add a mesh, the key lines below animate it
+//   key FRAME RX RY RZ TX TY TZ [SX SY SZ]
+//   camera FRAME X Y Z            camera position keyframe
+//
+// Transforms are interpolated linearly between keyframes and hold their
+// first and last values outside of them. Lines starting with # are ignored.
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+  int frame;
+  vec3_t rotation;
+  vec3_t translation;
+  vec3_t scale;
+} keyframe_t;
+
+typedef struct {
+  char obj_filename[JOB_PATH_LENGTH];
+  char texture_filename[JOB_PATH_LENGTH];
+  keyframe_t keys[MAX_KEYFRAMES];
+  int num_keys;
+} job_mesh_t;
+
+typedef struct {
+  int width;
+  int height;
+  int first_frame;
+  int last_frame;
+  int shards;
+  char output[JOB_PATH_LENGTH];
+  job_mesh_t meshes[MAX_MESHES];
+  int num_meshes;
+  keyframe_t camera[MAX_KEYFRAMES]; // only the translation is used
+  int num_camera_keys;
+} job_t;
+
+// Renders the frames first..last of the job, called once per shard from a scheduler task.
+typedef bool (*job_shard_t)(const job_t *job, int first, int last);
+
+bool job_load(job_t *job, const char *filename);
+bool job_load_meshes(render_context_t *context, const job_t *job);
+void job_pose(render_context_t *context, const job_t *job, int frame);
+bool job_run(const job_t *job, int shards, job_shard_t render_shard);
+
+#endif
@@ -1,7 +1,5 @@
 #include "light.h"
 
-light_t light = {.direction = {0, 0, 1}};
-
 void clamp_float(float min, float max, float *x) {
   if (*x < min) {
     *x = min;
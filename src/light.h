@@ -8,8 +8,6 @@ typedef struct {
   vec3_t direction;
 } light_t;
 
-extern light_t light;
-
 color_t light_apply_intensity(color_t c, float percentage_factor);
 
 #endif
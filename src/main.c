@@ -1,274 +1,323 @@
 #include "array.h"
+#include "backend.h"
+#include "bench.h"
+#include "clock.h"
 #include "colors.h"
+#include "context.h"
 #include "display.h"
-#include "light.h"
-#include "matrix.h"
+#include "golden.h"
+#include "image.h"
+#include "job.h"
+#include "memory.h"
 #include "mesh.h"
+#include "options.h"
+#include "pacing.h"
+#include "pipeline.h"
+#include "profiler.h"
+#include "render.h"
+#include "resolution.h"
+#include "scheduler.h"
 #include "settings.h"
 #include "state.h"
+#include "stats.h"
+#include "synthetic.h"
 #include "texture.h"
+#include "trace.h"
 #include "upng.h"
 #include "user_input.h"
 #include "vector.h"
+#include "video_output.h"
+#include "virtual_texture.h"
 
 #include <SDL2/SDL.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
-// Array of triangles that should be rendered frame by frame.
-#define MAX_TRIANGLES_PER_MESH 10000
-triangle_t triangles_to_render[MAX_TRIANGLES_PER_MESH];
-int num_triangles_to_render = 0;
-
-int previous_frame_time = 0;
-
-mat4_t proj_matrix;
-
-void setup(void) {
-  render_method = RENDER_TEXTURED;
-  cull_method = CULL_BACKFACE;
-  /*
-  There is a possibility that malloc will fail to allocate that number of bytes
-  in memory, e.g., when the machine does not have enough free memory. If that
-  happens, malloc will return a NULL pointer. Since the main goal of this course
-  is to learn the fundamentals of computer graphics and since this is basically
-  an academic exercise, we avoid doing exhaustive, professional checks.
-  */
-  color_buffer = (color_t *)malloc(sizeof(color_t) * window_width * window_height);
-  z_buffer = (float *)malloc(sizeof(float) * window_width * window_height);
-
-  color_buffer_texture = SDL_CreateTexture(
-      renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, window_width, window_height);
-
-  float fov = M_PI / 3.0;
-  float aspect = (float)window_height / (float)window_width;
-  float znear = 0.1;
-  float zfar = 100.0;
-  proj_matrix = mat4_make_perspective(fov, aspect, znear, zfar);
-
-  // load_obj_file_data("./assets/cube.obj");
-  // load_png_texture_data("./assets/cube.png");
-  // load_obj_file_data("./assets/f22.obj");
-  // load_png_texture_data("./assets/f22.png");
-  // load_obj_file_data("./assets/efa.obj");
-  // load_png_texture_data("./assets/efa.png");
-  load_obj_file_data("./assets/drone.obj");
-  load_png_texture_data("./assets/drone.png");
-  // load_obj_file_data("./assets/f117.obj");
-  // load_png_texture_data("./assets/f117.png");
-  // load_obj_file_data("./assets/crab.obj");
-  // load_png_texture_data("./assets/crab.png");
+#define SCENE_DISTANCE 5.0 // from the camera to the meshes of the scene
+
+// Change the mesh scale, rotation, and translation values per animation frame
+static void spin_meshes(render_context_t *context, int frame) {
+  (void)frame;
+  for (int i = 0; i < context->mesh_count; i++) {
+    // context->meshes[i].rotation.x += 0.01;
+    context->meshes[i].rotation.y += 0.02;
+    // context->meshes[i].rotation.z += 0.01;
+  }
 }
 
-void do_delay(void) {
-  // Wait some time until the reach the target frame time in milliseconds
-  int time_to_wait = FRAME_TARGET_TIME - (SDL_GetTicks() - previous_frame_time);
+// Apply the command line to a freshly initialized context.
+void setup(render_context_t *context) {
+  context->settings.render_method = options.render_method;
+  context->settings.front_to_back = options.front_to_back;
+  context->animate = spin_meshes;
+}
+
+// Add a generated scene in front of the camera, sized relative to the screen.
+static bool load_synthetic_scene(render_context_t *context, const synthetic_scene_t *scene) {
+  float view_height = 2 * SCENE_DISTANCE * tan(FIELD_OF_VIEW / 2);
+  return synthetic_load(context, scene, SCENE_DISTANCE, view_height);
+}
 
-  // Only delay execution if we are running too fast
-  if (time_to_wait > 0 && time_to_wait <= FRAME_TARGET_TIME) {
-    SDL_Delay(time_to_wait);
+bool load_scene(render_context_t *context) {
+  if (options.num_scenes > 0) {
+    for (int i = 0; i < options.num_scenes; i++) {
+      if (!load_synthetic_scene(context, &options.scenes[i])) {
+        return false;
+      }
+    }
+    return true;
   }
 
-  previous_frame_time = SDL_GetTicks();
+  // Other models in ./assets: cube, f22, efa, f117 and crab, pick one with --mesh and --texture.
+  // Huge textures can be baked with --bake-vtex and paged in from disk by passing the .vtex file.
+  vec3_t scale = {1.0, 1.0, 1.0};
+  vec3_t rotation = {0, 0, 0};
+  vec3_t translation = {0, 0, SCENE_DISTANCE};
+  return load_mesh(context, options.mesh_file, options.texture_file, scale, rotation,
+                   translation);
 }
 
-void update(void) {
-  do_delay();
-
-  num_triangles_to_render = 0;
-
-  // Change the mesh scale, rotation, and translation values per animation frame
-  // mesh.rotation.x += 0.01;
-  mesh.rotation.y += 0.02;
-  // mesh.rotation.z += 0.01;
-  mesh.translation.z = 5.0;
-
-  mat4_t scale_matrix = mat4_make_scale(mesh.scale);
-  mat4_t translation_matrix = mat4_make_translation(mesh.translation);
-  mat4_t rotation_matrix_x = mat4_make_rotation_x(mesh.rotation.x);
-  mat4_t rotation_matrix_y = mat4_make_rotation_y(mesh.rotation.y);
-  mat4_t rotation_matrix_z = mat4_make_rotation_z(mesh.rotation.z);
-
-  int num_faces = array_length(mesh.faces);
-  for (int i = 0; i < num_faces; i++) {
-    face_t mesh_face = mesh.faces[i];
-
-    vec3_t face_vertices[3];
-    face_vertices[0] = mesh.vertices[mesh_face.a - 1];
-    face_vertices[1] = mesh.vertices[mesh_face.b - 1];
-    face_vertices[2] = mesh.vertices[mesh_face.c - 1];
-
-    vec4_t transformed_vertices[3];
-    for (int j = 0; j < 3; j++) {
-      vec4_t transformed_vertex = vec4_from_vec3(face_vertices[j]);
-
-      // Do some transformations...order matters!
-      // 1) Scale
-      // 2) Rotate
-      // 3) Translate
-      mat4_t world_matrix = mat4_identity();
-      world_matrix = mat4_mul_mat4(scale_matrix, world_matrix);
-      world_matrix = mat4_mul_mat4(rotation_matrix_z, world_matrix);
-      world_matrix = mat4_mul_mat4(rotation_matrix_y, world_matrix);
-      world_matrix = mat4_mul_mat4(rotation_matrix_x, world_matrix);
-      world_matrix = mat4_mul_mat4(translation_matrix, world_matrix);
-
-      transformed_vertex = mat4_mul_vec4(world_matrix, transformed_vertex);
-
-      transformed_vertices[j] = transformed_vertex;
+///////////////////////////////////////////////////////////////////////////////
+// Render one benchmark scene offscreen, timing every frame from building its
+// geometry to handing it to the backend.
+///////////////////////////////////////////////////////////////////////////////
+bool bench_scene(const bench_scene_t *scene, bench_result_t *result) {
+  render_context_t context;
+  if (!render_context_init(&context, NULL, options.width, options.height)) {
+    return false;
+  }
+  setup(&context);
+
+  bool ok;
+  if (scene->synthetic != NULL) {
+    ok = load_synthetic_scene(&context, scene->synthetic);
+  } else {
+    vec3_t scale = {1.0, 1.0, 1.0};
+    vec3_t rotation = {0, 0, 0};
+    vec3_t translation = {0, 0, SCENE_DISTANCE};
+    ok = load_mesh(&context, scene->obj_filename, scene->texture_filename, scale, rotation,
+                   translation);
+  }
+
+  if (ok) {
+    result->faces = count_mesh_faces(&context);
+    pipeline_init(&context, render_geometry, result->faces);
+    for (int i = 0; i < BENCH_WARMUP_FRAMES; i++) {
+      render_frame(&context, pipeline_next_frame(&context));
+      present_display(&context);
     }
 
-    // Get individual vectors from A, B, and C vertices to compute normal
-    vec3_t vector_a = vec3_from_vec4(transformed_vertices[0]); /*   A   */
-    vec3_t vector_b = vec3_from_vec4(transformed_vertices[1]); /*  / \  */
-    vec3_t vector_c = vec3_from_vec4(transformed_vertices[2]); /* C---B */
-
-    // Get the vector subtraction of B-A and C-A
-    vec3_t vector_ab = vec3_sub(vector_b, vector_a);
-    vec3_t vector_ac = vec3_sub(vector_c, vector_a);
-    vec3_normalize(&vector_ab);
-    vec3_normalize(&vector_ac);
-
-    vec3_t surface_normal = vec3_cross(vector_ab, vector_ac);
-    vec3_normalize(&surface_normal);
-    vec3_t camera_ray = vec3_sub(camera_position, vector_a);
-
-    // Cull triangles that are not facing the camera.
-    if (cull_method == CULL_BACKFACE) {
-      if (vec3_dot(surface_normal, camera_ray) < 0) {
-        continue;
-      }
+    uint64_t bench_start = clock_ns();
+    for (int i = 0; i < result->frames; i++) {
+      uint64_t frame_start = clock_ns();
+      triangle_list_t *triangles_to_render = pipeline_next_frame(&context);
+      result->geometry_ms += clock_ms_since(frame_start);
+      uint64_t render_start = clock_ns();
+      render_frame(&context, triangles_to_render);
+      result->render_ms += clock_ms_since(render_start);
+      present_display(&context);
+      result->frame_times[i] = clock_ms_since(frame_start);
+      result->triangles += context.stats.triangles_rasterized;
+      result->pixels += context.stats.pixels_shaded;
     }
+    result->seconds = clock_ms_since(bench_start) / 1000.0;
+    pipeline_destroy(&context);
+  }
 
-    vec4_t projected_points[3];
+  render_context_destroy(&context);
+  return ok;
+}
 
-    for (int i = 0; i < 3; i++) {
-      projected_points[i] = mat4_mul_vec4_project(proj_matrix, transformed_vertices[i]);
+///////////////////////////////////////////////////////////////////////////////
+// Render a single frame of a golden image case offscreen and copy out its
+// colors and depths.
+///////////////////////////////////////////////////////////////////////////////
+bool golden_scene(const golden_case_t *golden_case, color_t *pixels, float *depth) {
+  render_context_t context;
+  if (!render_context_init(&context, NULL, golden_case->width, golden_case->height)) {
+    return false;
+  }
+  setup(&context);
+  context.settings.render_method = golden_case->render_method;
+  context.settings.texture_filter = golden_case->texture_filter;
+  context.settings.texture_layout = golden_case->texture_layout;
+
+  vec3_t scale = {1.0, 1.0, 1.0};
+  vec3_t rotation = {0, golden_case->rotation_y, 0};
+  vec3_t translation = {0, 0, SCENE_DISTANCE};
+  bool ok = load_mesh(&context, golden_case->obj_filename, golden_case->texture_filename, scale,
+                      rotation, translation);
+
+  if (ok) {
+    pipeline_init(&context, render_geometry, count_mesh_faces(&context));
+    render_frame(&context, pipeline_next_frame(&context));
+    int count = context.window_width * context.window_height;
+    memcpy(pixels, display_frame(&context), sizeof(color_t) * count);
+    memcpy(depth, context.z_buffer, sizeof(float) * count);
+    pipeline_destroy(&context);
+  }
 
-      // Scale into the viewport.
-      projected_points[i].x *= (window_width / 2.0);
-      projected_points[i].y *= (window_height / 2.0);
+  render_context_destroy(&context);
+  return ok;
+}
 
-      // Invert the y values to account for flipped screen y coordinates.
-      projected_points[i].y *= -1;
+// What a shard's animation needs to pose its frames.
+typedef struct {
+  const job_t *job;
+  int first_frame;
+} shard_pose_t;
 
-      // Translate the projected points to the middle of the screen.
-      projected_points[i].x += (window_width / 2.0);
-      projected_points[i].y += (window_height / 2.0);
-    }
+static void pose_shard(render_context_t *context, int frame) {
+  const shard_pose_t *shard = (const shard_pose_t *)context->animate_data;
+  job_pose(context, shard->job, shard->first_frame + frame);
+}
 
-    float light_intensity_factor = -vec3_dot(surface_normal, light.direction);
-    color_t adjusted_color = light_apply_intensity(mesh_face.color, light_intensity_factor);
-    triangle_t projected_triangle = {
-        .points =
-            {
-                {
-                    projected_points[0].x,
-                    projected_points[0].y,
-                    projected_points[0].z,
-                    projected_points[0].w,
-                },
-                {
-                    projected_points[1].x,
-                    projected_points[1].y,
-                    projected_points[1].z,
-                    projected_points[1].w,
-                },
-                {
-                    projected_points[2].x,
-                    projected_points[2].y,
-                    projected_points[2].z,
-                    projected_points[2].w,
-                },
-            },
-        .texcoords =
-            {
-                mesh_face.a_uv,
-                mesh_face.b_uv,
-                mesh_face.c_uv,
-            },
-        .color = adjusted_color,
-    };
-
-    if (num_triangles_to_render < MAX_TRIANGLES_PER_MESH) {
-      triangles_to_render[num_triangles_to_render] = projected_triangle;
-      num_triangles_to_render += 1;
-    }
+///////////////////////////////////////////////////////////////////////////////
+// Render the frames first..last of the batch job offscreen, as fast as
+// possible, writing each one to the job's output pattern. Runs as a task of
+// the scheduler, next to the other shards.
+///////////////////////////////////////////////////////////////////////////////
+bool render_shard(const job_t *job, int first, int last) {
+  render_context_t context;
+  if (!render_context_init(&context, NULL, job->width, job->height)) {
+    return false;
   }
+  setup(&context);
+  shard_pose_t shard = {.job = job, .first_frame = first};
+  context.animate = pose_shard;
+  context.animate_data = &shard;
+  bool ok = job_load_meshes(&context, job);
+
+  // Geometry of the next frame overlaps rasterization of this one.
+  context.settings.frame_pipelining = true;
+  pipeline_init(&context, render_geometry, count_mesh_faces(&context));
+
+  for (int i = first; ok && i <= last; i++) {
+    triangle_list_t *triangles_to_render = pipeline_next_frame(&context);
+    int frame = first + triangles_to_render->frame;
+    render_frame(&context, triangles_to_render);
+
+    char filename[JOB_PATH_LENGTH + 16];
+    snprintf(filename, sizeof(filename), job->output, frame);
+    ok = write_ppm(filename, display_frame(&context), job->width, job->height, job->width);
+  }
+
+  pipeline_destroy(&context);
+  render_context_destroy(&context);
+  return ok;
 }
 
-void render(void) {
-  draw_grid(50);
+int main(int argc, char *argv[]) {
+  if (!parse_options(argc, argv)) {
+    return 1;
+  }
 
-  for (int i = 0; i < num_triangles_to_render; i++) {
-    triangle_t t = triangles_to_render[i];
+  // Offline step: cut a PNG into the tiled mip chain used by virtual textures.
+  if (options.bake_vtex_input != NULL) {
+    return virtual_texture_bake(options.bake_vtex_input, options.bake_vtex_output) ? 0 : 1;
+  }
 
-    // Draw filled triangle
-    if (render_method == RENDER_FILL_TRIANGLE || render_method == RENDER_FILL_TRIANGLE_WIRE) {
-      draw_filled_triangle(t.points[0].x, t.points[0].y, t.points[0].z, t.points[0].w, // vertex A
-                           t.points[1].x, t.points[1].y, t.points[1].z, t.points[1].w, // vertex B
-                           t.points[2].x, t.points[2].y, t.points[2].z, t.points[2].w, // vertex C
-                           t.color);
-    }
+  if (!scheduler_init(options.threads, options.pin_threads)) {
+    return 1;
+  }
 
-    // Draw textured triangle
-    if (render_method == RENDER_TEXTURED || render_method == RENDER_TEXTURED_WIRE) {
-      draw_textured_triangle(
-          t.points[0].x, t.points[0].y, t.points[0].z, t.points[0].w, t.texcoords[0].u,
-          t.texcoords[0].v, // vertex A
-          t.points[1].x, t.points[1].y, t.points[1].z, t.points[1].w, t.texcoords[1].u,
-          t.texcoords[1].v, // vertex B
-          t.points[2].x, t.points[2].y, t.points[2].z, t.points[2].w, t.texcoords[2].u,
-          t.texcoords[2].v, // vertex C
-          mesh_texture);
+  if (options.bench) {
+    if (options.width <= 0) {
+      options.width = 800;
+      options.height = 600;
     }
+    int frames = options.frames > 0 ? options.frames : BENCH_DEFAULT_FRAMES;
+    int status = bench_run(frames, options.width, options.height, options.bench_output,
+                           options.baseline_file, options.threshold, options.scenes,
+                           options.num_scenes, bench_scene);
+    scheduler_shutdown();
+    return status;
+  }
 
-    // Draw triangle wireframe
-    if (render_method == RENDER_WIRE || render_method == RENDER_WIRE_VERTEX ||
-        render_method == RENDER_FILL_TRIANGLE_WIRE || render_method == RENDER_TEXTURED_WIRE) {
-      draw_triangle(t.points[0].x, t.points[0].y, // vertex A
-                    t.points[1].x, t.points[1].y, // vertex B
-                    t.points[2].x, t.points[2].y, // vertex C
-                    WHITE);
-    }
+  if (options.golden_dir != NULL) {
+    int status = golden_run(options.golden_dir, options.golden_update, options.tolerance,
+                            options.depth_tolerance, golden_scene);
+    scheduler_shutdown();
+    return status;
+  }
 
-    // Draw triangle vertex points
-    if (render_method == RENDER_WIRE_VERTEX) {
-      draw_rect(t.points[0].x - 3, t.points[0].y - 3, 6, 6, BLACK); // vertex A
-      draw_rect(t.points[1].x - 3, t.points[1].y - 3, 6, 6, BLACK); // vertex B
-      draw_rect(t.points[2].x - 3, t.points[2].y - 3, 6, 6, BLACK); // vertex C
+  if (options.job_file != NULL) {
+    job_t batch_job;
+    bool ok = job_load(&batch_job, options.job_file);
+    if (ok) {
+      uint64_t job_start = clock_ns();
+      ok = job_run(&batch_job, options.shards, render_shard);
+      fprintf(stderr, "%d frames at %dx%d in %.3f s\n",
+              batch_job.last_frame - batch_job.first_frame + 1, batch_job.width,
+              batch_job.height, clock_ms_since(job_start) / 1000.0);
     }
+    scheduler_shutdown();
+    return ok ? 0 : 1;
   }
 
-  render_color_buffer();
-  clear_color_buffer(0x00000000);
-  clear_z_buffer();
-
-  SDL_RenderPresent(renderer);
-}
+  // Offscreen frames are not shown to anyone, so by default they are rendered as fast as possible.
+  pacing_mode = options.pacing_given ? options.pacing
+                                     : (options.headless ? PACING_UNCAPPED : PACING_FIXED);
+  target_frame_time = 1000.0 / options.fps;
+  profiling = options.profile_file != NULL || options.trace_file != NULL;
+  if (options.trace_file != NULL && !trace_open(options.trace_file)) {
+    scheduler_shutdown();
+    return 1;
+  }
 
-void free_resources(void) {
-  free(color_buffer);
-  array_free(mesh.vertices);
-  array_free(mesh.faces);
-  upng_free(png_texture);
-}
+  // Headless runs never touch SDL, so they work without a display.
+  display_backend_t *backend = options.headless ? &offscreen_backend : &sdl_backend;
+  render_context_t context;
+  is_running = render_context_init(&context, backend, options.width, options.height);
+  if (is_running && options.output_file != NULL) {
+    is_running = video_output_open(options.output_file, options.output_format,
+                                   context.window_width, context.window_height, FPS);
+  }
 
-int main(void) {
-  is_running = initialize_window();
+  setup(&context);
+  is_running = is_running && load_scene(&context);
+  pipeline_init(&context, render_geometry, count_mesh_faces(&context));
+  pacing_init(backend);
 
-  setup();
+  int frame_count = 0;
+  uint64_t run_start = clock_ns();
 
   while (is_running) {
-    process_input();
-    update();
-    render();
+    pacing_begin_frame();
+    uint64_t input_start = profile_begin();
+    backend->process_input(&context);
+    profile_end(PROFILE_INPUT, input_start);
+    render_frame(&context, pipeline_next_frame(&context));
+    pacing_present();
+    profiler_end_frame();
+    update_dynamic_resolution(&context, frame_timing.cpu_time);
+
+    frame_count++;
+    if (options.frames > 0 && frame_count >= options.frames) {
+      is_running = false;
+    }
+  }
+
+  if (options.headless) {
+    double seconds = clock_ms_since(run_start) / 1000.0;
+    fprintf(stderr, "%d frames at %dx%d in %.3f s (%.1f fps)\n", frame_count,
+            context.window_width, context.window_height, seconds, frame_count / seconds);
+  }
+  pacing_print_summary();
+  memory_print_summary();
+  if (options.profile_file != NULL) {
+    profiler_dump(options.profile_file);
   }
 
-  destroy_window();
-  free_resources();
+  pipeline_destroy(&context);
+  video_output_close();
+  render_context_destroy(&context);
+  scheduler_shutdown();
+  trace_close();
+  profiler_free();
 
   return 0;
 }
@@ -71,16 +71,19 @@ mat4_t mat4_make_perspective(float fov, float aspect, float znear, float zfar) {
 
 vec4_t mat4_mul_vec4_project(mat4_t mat_proj, vec4_t v) {
   // Multiply the projection matrix by our original vector.
-  vec4_t result = mat4_mul_vec4(mat_proj, v);
+  return perspective_divide(mat4_mul_vec4(mat_proj, v));
+}
 
+// From clip space to normalized device coordinates, keeping w for perspective correction.
+vec4_t perspective_divide(vec4_t v) {
   // Perform perspective divide with original z-value that is now stored in w.
-  if (result.w != 0.0) {
-    result.x /= result.w;
-    result.y /= result.w;
-    result.z /= result.w;
+  if (v.w != 0.0) {
+    v.x /= v.w;
+    v.y /= v.w;
+    v.z /= v.w;
   }
 
-  return result;
+  return v;
 }
 
 mat4_t mat4_mul_mat4(mat4_t m1, mat4_t m2) {
@@ -0,0 +1,106 @@
+#include "memory.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Keeps the blocks handed out aligned like malloc()'s on 64-bit systems.
+#define MEMORY_HEADER_SIZE 16
+
+typedef struct {
+  size_t size;
+  uint32_t category;
+  uint32_t offset; // from the start of the malloc()'d block to the user's pointer
+} memory_header_t;
+
+const char *memory_category_names[NUM_MEMORY_CATEGORIES] = {
+    "mesh", "texture", "framebuffer", "frame", "scratch",
+};
+
+static memory_usage_t usage[NUM_MEMORY_CATEGORIES];
+
+void memory_track(enum memory_category category, int64_t size) {
+  memory_usage_t *u = &usage[category];
+  int64_t current = __atomic_add_fetch(&u->current, size, __ATOMIC_RELAXED);
+  int64_t peak = __atomic_load_n(&u->peak, __ATOMIC_RELAXED);
+  while (current > peak && !__atomic_compare_exchange_n(&u->peak, &peak, current, true,
+                                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+static void *track_block(void *block, size_t offset, enum memory_category category, size_t size) {
+  if (block == NULL) {
+    return NULL;
+  }
+  uint8_t *pointer = (uint8_t *)block + offset;
+  memory_header_t *header = (memory_header_t *)(pointer - MEMORY_HEADER_SIZE);
+  header->size = size;
+  header->category = category;
+  header->offset = (uint32_t)offset;
+
+  __atomic_add_fetch(&usage[category].allocations, 1, __ATOMIC_RELAXED);
+  memory_track(category, (int64_t)size);
+  return pointer;
+}
+
+void *memory_alloc(enum memory_category category, size_t size) {
+  return track_block(malloc(MEMORY_HEADER_SIZE + size), MEMORY_HEADER_SIZE, category, size);
+}
+
+void *memory_calloc(enum memory_category category, size_t count, size_t size) {
+  void *pointer = memory_alloc(category, count * size);
+  if (pointer != NULL) {
+    memset(pointer, 0, count * size);
+  }
+  return pointer;
+}
+
+// The alignment must be a power of two.
+void *memory_alloc_aligned(enum memory_category category, size_t size, size_t alignment) {
+  if (alignment <= MEMORY_HEADER_SIZE) {
+    return memory_alloc(category, size);
+  }
+  uint8_t *block = (uint8_t *)malloc(MEMORY_HEADER_SIZE + alignment + size);
+  if (block == NULL) {
+    return NULL;
+  }
+  uintptr_t start = (uintptr_t)block + MEMORY_HEADER_SIZE;
+  uintptr_t aligned = (start + alignment - 1) & ~(uintptr_t)(alignment - 1);
+  return track_block(block, aligned - (uintptr_t)block, category, size);
+}
+
+void memory_free(void *pointer) {
+  if (pointer == NULL) {
+    return;
+  }
+  memory_header_t *header = (memory_header_t *)((uint8_t *)pointer - MEMORY_HEADER_SIZE);
+  __atomic_sub_fetch(&usage[header->category].allocations, 1, __ATOMIC_RELAXED);
+  memory_track(header->category, -(int64_t)header->size);
+  free((uint8_t *)pointer - header->offset);
+}
+
+memory_usage_t memory_usage(enum memory_category category) {
+  memory_usage_t u;
+  u.current = __atomic_load_n(&usage[category].current, __ATOMIC_RELAXED);
+  u.peak = __atomic_load_n(&usage[category].peak, __ATOMIC_RELAXED);
+  u.allocations = __atomic_load_n(&usage[category].allocations, __ATOMIC_RELAXED);
+  return u;
+}
+
+// Start measuring peaks from the current usage, e.g. for each benchmark scene.
+void memory_reset_peaks(void) {
+  for (int i = 0; i < NUM_MEMORY_CATEGORIES; i++) {
+    __atomic_store_n(&usage[i].peak, memory_usage(i).current, __ATOMIC_RELAXED);
+  }
+}
+
+void memory_print_summary(void) {
+  fprintf(stderr, "memory");
+  for (int i = 0; i < NUM_MEMORY_CATEGORIES; i++) {
+    memory_usage_t u = memory_usage(i);
+    fprintf(stderr, "%s %s %.2f MB (peak %.2f MB)", i > 0 ? "," : "", memory_category_names[i],
+            u.current / 1048576.0, u.peak / 1048576.0);
+  }
+  fprintf(stderr, "\n");
+}
@@ -0,0 +1,50 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Tracked allocations. Every block is charged to a category, and the current
+// and peak bytes of each category can be read at any time from any thread:
+//
+//   color_t *texels = (color_t *)memory_alloc(MEMORY_TEXTURE, size);
+//   ...
+//   memory_free(texels);
+//
+// Blocks carry a small header with their size and category, so they must be
+// released with memory_free(), never free(). Memory owned by code that can't
+// be changed (the mesh arrays, upng's buffers) is charged by hand with
+// memory_track().
+////////////////////////////////////////////////////////////////////////////////
+
+enum memory_category {
+  MEMORY_MESH,        // vertices and faces
+  MEMORY_TEXTURE,     // texels, mip chains and virtual texture caches
+  MEMORY_FRAMEBUFFER, // color, depth and other per-pixel buffers
+  MEMORY_FRAME,       // per-frame data: triangle lists, queued video frames, profiler events
+  MEMORY_SCRATCH,     // temporary buffers for decoding, encoding and tools
+  NUM_MEMORY_CATEGORIES
+};
+
+typedef struct {
+  int64_t current; // bytes
+  int64_t peak;
+  int64_t allocations; // blocks currently allocated
+} memory_usage_t;
+
+extern const char *memory_category_names[NUM_MEMORY_CATEGORIES];
+
+void *memory_alloc(enum memory_category category, size_t size);
+void *memory_calloc(enum memory_category category, size_t count, size_t size);
+void *memory_alloc_aligned(enum memory_category category, size_t size, size_t alignment);
+void memory_free(void *pointer);
+
+// Charge (or with a negative size, release) memory allocated elsewhere.
+void memory_track(enum memory_category category, int64_t size);
+
+memory_usage_t memory_usage(enum memory_category category);
+void memory_reset_peaks(void);
+void memory_print_summary(void);
+
+#endif
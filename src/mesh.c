@@ -1,56 +1,190 @@
 #include "mesh.h"
 #include "array.h"
+#include "context.h"
+#include "memory.h"
+#include "profiler.h"
 #include <stdio.h>
 #include <string.h>
 
-mesh_t mesh = {
-    .vertices = NULL,
-    .faces = NULL,
-    .rotation = {0, 0, 0},
-    .scale = {1.0, 1.0, 1.0},
-    .translation = {0, 0, 0},
-};
+// The arrays grow inside array.h, so what they hold is charged to the mesh memory by hand.
+static int64_t mesh_data_size(const mesh_t *mesh) {
+  return (int64_t)array_length(mesh->vertices) * sizeof(vec3_t) +
+         (int64_t)array_length(mesh->faces) * sizeof(face_t);
+}
+
+static void free_mesh_data(mesh_t *mesh) {
+  memory_track(MEMORY_MESH, -mesh_data_size(mesh));
+  array_free(mesh->vertices);
+  array_free(mesh->faces);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Add a mesh to the scene, with its own texture and initial transform. The
+// texture is stored in the layout of the context's settings.
+///////////////////////////////////////////////////////////////////////////////
+bool load_mesh(render_context_t *context, const char *obj_filename, const char *texture_filename,
+               vec3_t scale, vec3_t rotation, vec3_t translation) {
+  if (context->mesh_count == MAX_MESHES) {
+    fprintf(stderr, "Too many meshes, %s not loaded.\n", obj_filename);
+    return false;
+  }
+
+  uint64_t start = profile_begin();
+  mesh_t mesh;
+  memset(&mesh, 0, sizeof(mesh));
+  if (!load_obj_file_data(&mesh, obj_filename)) {
+    return false;
+  }
+  if (!load_texture(&mesh.texture, texture_filename, context->settings.texture_layout)) {
+    fprintf(stderr, "Error loading texture %s.\n", texture_filename);
+    array_free(mesh.vertices);
+    array_free(mesh.faces);
+    return false;
+  }
+  profile_end(PROFILE_LOAD, start);
+  mesh.scale = scale;
+  mesh.rotation = rotation;
+  mesh.translation = translation;
+  return add_mesh(context, &mesh);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Same as load_mesh(), from an OBJ file and a PNG texture already in memory,
+// e.g. received over the network. The data is only read during the call.
+///////////////////////////////////////////////////////////////////////////////
+bool load_mesh_data(render_context_t *context, const char *obj_data, size_t obj_size,
+                    const unsigned char *png_data, size_t png_size, vec3_t scale,
+                    vec3_t rotation, vec3_t translation) {
+  if (context->mesh_count == MAX_MESHES) {
+    fprintf(stderr, "Too many meshes.\n");
+    return false;
+  }
+
+  uint64_t start = profile_begin();
+  mesh_t mesh;
+  memset(&mesh, 0, sizeof(mesh));
+  load_obj_data(&mesh, obj_data, obj_size);
+  if (!load_png_texture_memory(&mesh.texture, png_data, png_size,
+                               context->settings.texture_layout)) {
+    fprintf(stderr, "Error loading texture from memory.\n");
+    array_free(mesh.vertices);
+    array_free(mesh.faces);
+    return false;
+  }
+  profile_end(PROFILE_LOAD, start);
+  mesh.scale = scale;
+  mesh.rotation = rotation;
+  mesh.translation = translation;
+  return add_mesh(context, &mesh);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Add a mesh built in memory to the scene, which takes over its arrays and
+// texture. On failure they still belong to the caller.
+///////////////////////////////////////////////////////////////////////////////
+bool add_mesh(render_context_t *context, const mesh_t *mesh) {
+  if (context->mesh_count == MAX_MESHES) {
+    fprintf(stderr, "Too many meshes.\n");
+    return false;
+  }
+  context->meshes[context->mesh_count++] = *mesh;
+  memory_track(MEMORY_MESH, mesh_data_size(mesh));
+  return true;
+}
+
+// Faces of every mesh in the scene, which is how many triangles a frame can have at most.
+int count_mesh_faces(const render_context_t *context) {
+  int count = 0;
+  for (int i = 0; i < context->mesh_count; i++) {
+    count += array_length(context->meshes[i].faces);
+  }
+  return count;
+}
 
-void load_obj_file_data(char *filename) {
+// Add what one line of an OBJ file describes to the mesh. Faces refer to the texture coordinates
+// seen so far, which are collected in texcoords.
+static void parse_obj_line(mesh_t *mesh, tex2_t **texcoords, const char *line) {
+  // Vertex information
+  if (strncmp(line, "v ", 2) == 0) {
+    vec3_t vertex;
+    sscanf(line, "v %f %f %f", &vertex.x, &vertex.y, &vertex.z);
+    array_push(mesh->vertices, vertex);
+  }
+
+  // Texture coordinate information
+  if (strncmp(line, "vt ", 3) == 0) {
+    tex2_t texcoord;
+    sscanf(line, "vt %f %f", &texcoord.u, &texcoord.v);
+    array_push(*texcoords, texcoord);
+  }
+
+  // Face information
+  if (strncmp(line, "f ", 2) == 0) {
+    int vertex_indices[3];
+    int texture_indices[3];
+    int normal_indices[3];
+    sscanf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d", &vertex_indices[0], &texture_indices[0],
+           &normal_indices[0], &vertex_indices[1], &texture_indices[1], &normal_indices[1],
+           &vertex_indices[2], &texture_indices[2], &normal_indices[2]);
+    face_t face = {
+        .a = vertex_indices[0],
+        .b = vertex_indices[1],
+        .c = vertex_indices[2],
+        .a_uv = (*texcoords)[texture_indices[0] - 1],
+        .b_uv = (*texcoords)[texture_indices[1] - 1],
+        .c_uv = (*texcoords)[texture_indices[2] - 1],
+        .color = WHITE,
+    };
+    array_push(mesh->faces, face);
+  }
+}
+
+bool load_obj_file_data(mesh_t *mesh, const char *filename) {
   FILE *file;
   file = fopen(filename, "r");
+  if (file == NULL) {
+    fprintf(stderr, "Error opening mesh %s.\n", filename);
+    return false;
+  }
   char line[1024];
 
   tex2_t *texcoords = NULL;
 
   while (fgets(line, 1024, file)) {
-    // Vertex information
-    if (strncmp(line, "v ", 2) == 0) {
-      vec3_t vertex;
-      sscanf(line, "v %f %f %f", &vertex.x, &vertex.y, &vertex.z);
-      array_push(mesh.vertices, vertex);
-    }
+    parse_obj_line(mesh, &texcoords, line);
+  }
 
-    // Texture coordinate information
-    if (strncmp(line, "vt ", 3) == 0) {
-      tex2_t texcoord;
-      sscanf(line, "vt %f %f", &texcoord.u, &texcoord.v);
-      array_push(texcoords, texcoord);
-    }
+  array_free(texcoords);
+  fclose(file);
+  return true;
+}
+
+// Same as load_obj_file_data(), from an OBJ file already in memory. Lines are cut at the same
+// length fgets() cuts them at there.
+void load_obj_data(mesh_t *mesh, const char *data, size_t size) {
+  char line[1024];
+
+  tex2_t *texcoords = NULL;
 
-    // Face information
-    if (strncmp(line, "f ", 2) == 0) {
-      int vertex_indices[3];
-      int texture_indices[3];
-      int normal_indices[3];
-      sscanf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d", &vertex_indices[0], &texture_indices[0],
-             &normal_indices[0], &vertex_indices[1], &texture_indices[1], &normal_indices[1],
-             &vertex_indices[2], &texture_indices[2], &normal_indices[2]);
-      face_t face = {
-          .a = vertex_indices[0],
-          .b = vertex_indices[1],
-          .c = vertex_indices[2],
-          .a_uv = texcoords[texture_indices[0] - 1],
-          .b_uv = texcoords[texture_indices[1] - 1],
-          .c_uv = texcoords[texture_indices[2] - 1],
-          .color = WHITE,
-      };
-      array_push(mesh.faces, face);
+  size_t start = 0;
+  while (start < size) {
+    size_t end = start;
+    while (end < size && data[end] != '\n' && end - start < sizeof(line) - 1) {
+      end++;
     }
+    memcpy(line, &data[start], end - start);
+    line[end - start] = '\0';
+    parse_obj_line(mesh, &texcoords, line);
+    start = end < size && data[end] == '\n' ? end + 1 : end;
+  }
+
+  array_free(texcoords);
+}
+
+void free_meshes(render_context_t *context) {
+  for (int i = 0; i < context->mesh_count; i++) {
+    free_mesh_data(&context->meshes[i]);
+    free_texture(&context->meshes[i].texture);
   }
+  context->mesh_count = 0;
 }
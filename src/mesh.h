@@ -1,9 +1,15 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include "texture.h"
 #include "triangle.h"
 #include "vector.h"
 
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MAX_MESHES 16
+
 ////////////////////////////////////////////////////////////////////////////////
 // Define a struct for dynamic size meshes, with array of vertices and faces
 ////////////////////////////////////////////////////////////////////////////////
@@ -13,10 +19,19 @@ typedef struct {
   vec3_t rotation;    // rotation with x, y, and z values
   vec3_t scale;       // scale with x, y, and z values
   vec3_t translation; // translation with x, y, and z values
+  texture_t texture;
 } mesh_t;
 
-extern mesh_t mesh;
-
-void load_obj_file_data(char *filename);
+// The meshes of a scene belong to a render context, see context.h.
+bool load_mesh(render_context_t *context, const char *obj_filename, const char *texture_filename,
+               vec3_t scale, vec3_t rotation, vec3_t translation);
+bool load_mesh_data(render_context_t *context, const char *obj_data, size_t obj_size,
+                    const unsigned char *png_data, size_t png_size, vec3_t scale,
+                    vec3_t rotation, vec3_t translation);
+bool add_mesh(render_context_t *context, const mesh_t *mesh);
+bool load_obj_file_data(mesh_t *mesh, const char *filename);
+void load_obj_data(mesh_t *mesh, const char *data, size_t size);
+int count_mesh_faces(const render_context_t *context);
+void free_meshes(render_context_t *context);
 
 #endif
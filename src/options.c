@@ -0,0 +1,187 @@
+#include "options.h"
+#include "bench.h"
+#include "golden.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+options_t options = {
+    .headless = false,
+    .width = 0,
+    .height = 0,
+    .frames = 0,
+    .pacing = PACING_FIXED,
+    .pacing_given = false,
+    .fps = FPS,
+    .profile_file = NULL,
+    .trace_file = NULL,
+    .render_method = RENDER_TEXTURED,
+    .front_to_back = false,
+    .mesh_file = "./assets/drone.obj",
+    .texture_file = "./assets/drone.png",
+    .num_scenes = 0,
+    .output_file = NULL,
+    .output_format = VIDEO_FORMAT_Y4M,
+    .bench = false,
+    .bench_output = NULL,
+    .baseline_file = NULL,
+    .threshold = BENCH_DEFAULT_THRESHOLD,
+    .golden_dir = NULL,
+    .golden_update = false,
+    .tolerance = GOLDEN_DEFAULT_TOLERANCE,
+    .depth_tolerance = GOLDEN_DEFAULT_DEPTH_TOLERANCE,
+    .job_file = NULL,
+    .shards = 0,
+    .threads = 0,
+    .pin_threads = false,
+    .bake_vtex_input = NULL,
+    .bake_vtex_output = NULL,
+};
+
+static const char *render_method_names[] = {
+    [RENDER_WIRE] = "wire",
+    [RENDER_WIRE_VERTEX] = "wire-vertex",
+    [RENDER_FILL_TRIANGLE] = "fill",
+    [RENDER_FILL_TRIANGLE_WIRE] = "fill-wire",
+    [RENDER_TEXTURED] = "textured",
+    [RENDER_TEXTURED_WIRE] = "textured-wire",
+    [RENDER_OVERDRAW] = "overdraw",
+};
+
+#define NUM_RENDER_METHODS (int)(sizeof(render_method_names) / sizeof(render_method_names[0]))
+
+static bool parse_render_method(const char *name, enum render_method *method) {
+  for (int i = 0; i < NUM_RENDER_METHODS; i++) {
+    if (strcmp(name, render_method_names[i]) == 0) {
+      *method = (enum render_method)i;
+      return true;
+    }
+  }
+  fprintf(stderr, "Unknown render method: %s\n", name);
+  return false;
+}
+
+static void print_usage(const char *program) {
+  int indent = (int)strlen(program);
+  fprintf(stderr,
+          "usage: %s [--headless] [--size WxH] [--frames N] [--mesh FILE.obj] [--texture FILE]\n",
+          program);
+  fprintf(stderr, "       %*s [--scene KIND[:TRIANGLES[:COVERAGE[:TEXTURE]]]]...\n", indent, "");
+  fprintf(stderr, "       %*s [--pacing uncapped|fixed|vsync] [--fps N]\n", indent, "");
+  fprintf(stderr, "       %*s [--render METHOD] [--front-to-back]\n", indent, "");
+  fprintf(stderr, "       %*s [--profile FILE] [--trace FILE]\n", indent, "");
+  fprintf(stderr, "       %*s [--output FILE|-] [--output-format y4m|ppm]\n", indent, "");
+  fprintf(stderr, "       %*s [--threads N] [--pin-threads]\n", indent, "");
+  fprintf(stderr, "       %s --bench [--frames N] [--size WxH] [--bench-output FILE]\n", program);
+  fprintf(stderr, "       %*s [--baseline FILE] [--threshold PERCENT] [--scene SPEC]...\n",
+          indent, "");
+  fprintf(stderr, "       %*s [--front-to-back]\n", indent, "");
+  fprintf(stderr, "       %s --golden DIR [--golden-update]\n", program);
+  fprintf(stderr, "       %*s [--tolerance N] [--depth-tolerance F]\n", indent, "");
+  fprintf(stderr, "       %s --job FILE [--shards N]\n", program);
+  fprintf(stderr, "       %s --bake-vtex IN.png OUT.vtex\n", program);
+}
+
+bool parse_options(int argc, char *argv[]) {
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+
+    if (strcmp(arg, "--headless") == 0) {
+      options.headless = true;
+    } else if (strcmp(arg, "--size") == 0 && has_value) {
+      if (sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2 ||
+          options.width <= 0 || options.height <= 0) {
+        fprintf(stderr, "Invalid size: %s\n", argv[i]);
+        return false;
+      }
+    } else if (strcmp(arg, "--frames") == 0 && has_value) {
+      options.frames = atoi(argv[++i]);
+    } else if (strcmp(arg, "--pacing") == 0 && has_value) {
+      const char *name = argv[++i];
+      options.pacing_given = true;
+      if (strcmp(name, "uncapped") == 0) {
+        options.pacing = PACING_UNCAPPED;
+      } else if (strcmp(name, "fixed") == 0) {
+        options.pacing = PACING_FIXED;
+      } else if (strcmp(name, "vsync") == 0) {
+        options.pacing = PACING_VSYNC;
+      } else {
+        fprintf(stderr, "Unknown pacing: %s\n", name);
+        return false;
+      }
+    } else if (strcmp(arg, "--fps") == 0 && has_value) {
+      options.fps = atof(argv[++i]);
+      if (options.fps <= 0) {
+        fprintf(stderr, "Invalid frame rate: %s\n", argv[i]);
+        return false;
+      }
+    } else if (strcmp(arg, "--profile") == 0 && has_value) {
+      options.profile_file = argv[++i];
+    } else if (strcmp(arg, "--trace") == 0 && has_value) {
+      options.trace_file = argv[++i];
+    } else if (strcmp(arg, "--render") == 0 && has_value) {
+      if (!parse_render_method(argv[++i], &options.render_method)) {
+        return false;
+      }
+    } else if (strcmp(arg, "--front-to-back") == 0) {
+      options.front_to_back = true;
+    } else if (strcmp(arg, "--mesh") == 0 && has_value) {
+      options.mesh_file = argv[++i];
+    } else if (strcmp(arg, "--texture") == 0 && has_value) {
+      options.texture_file = argv[++i];
+    } else if (strcmp(arg, "--scene") == 0 && has_value) {
+      if (options.num_scenes == OPTIONS_MAX_SCENES) {
+        fprintf(stderr, "Too many scenes, at most %d.\n", OPTIONS_MAX_SCENES);
+        return false;
+      }
+      if (!synthetic_parse(argv[++i], &options.scenes[options.num_scenes++])) {
+        return false;
+      }
+    } else if (strcmp(arg, "--output") == 0 && has_value) {
+      options.output_file = argv[++i];
+    } else if (strcmp(arg, "--output-format") == 0 && has_value) {
+      const char *name = argv[++i];
+      if (strcmp(name, "y4m") == 0) {
+        options.output_format = VIDEO_FORMAT_Y4M;
+      } else if (strcmp(name, "ppm") == 0) {
+        options.output_format = VIDEO_FORMAT_PPM;
+      } else {
+        fprintf(stderr, "Unknown output format: %s\n", name);
+        return false;
+      }
+    } else if (strcmp(arg, "--bench") == 0) {
+      options.bench = true;
+    } else if (strcmp(arg, "--bench-output") == 0 && has_value) {
+      options.bench_output = argv[++i];
+    } else if (strcmp(arg, "--baseline") == 0 && has_value) {
+      options.baseline_file = argv[++i];
+    } else if (strcmp(arg, "--threshold") == 0 && has_value) {
+      options.threshold = atof(argv[++i]);
+    } else if (strcmp(arg, "--golden") == 0 && has_value) {
+      options.golden_dir = argv[++i];
+    } else if (strcmp(arg, "--golden-update") == 0) {
+      options.golden_update = true;
+    } else if (strcmp(arg, "--tolerance") == 0 && has_value) {
+      options.tolerance = atoi(argv[++i]);
+    } else if (strcmp(arg, "--depth-tolerance") == 0 && has_value) {
+      options.depth_tolerance = atof(argv[++i]);
+    } else if (strcmp(arg, "--job") == 0 && has_value) {
+      options.job_file = argv[++i];
+    } else if (strcmp(arg, "--shards") == 0 && has_value) {
+      options.shards = atoi(argv[++i]);
+    } else if (strcmp(arg, "--threads") == 0 && has_value) {
+      options.threads = atoi(argv[++i]);
+    } else if (strcmp(arg, "--pin-threads") == 0) {
+      options.pin_threads = true;
+    } else if (strcmp(arg, "--bake-vtex") == 0 && i + 2 < argc) {
+      options.bake_vtex_input = argv[++i];
+      options.bake_vtex_output = argv[++i];
+    } else {
+      print_usage(argv[0]);
+      return false;
+    }
+  }
+  return true;
+}
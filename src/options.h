@@ -0,0 +1,84 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "settings.h"
+#include "synthetic.h"
+#include "video_output.h"
+
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Command line options:
+//
+//   --headless            render offscreen, without initializing SDL
+//   --size WxH            output size; fullscreen (or 800x600 headless) if unset
+//   --frames N            quit after N frames, 0 runs until closed
+//   --pacing MODE         uncapped, fixed or vsync; uncapped by default when headless
+//   --fps N               frame rate of the fixed pacing
+//   --profile FILE        time every frame's stages, dumped as CSV (or JSON for .json) on exit
+//   --trace FILE          write a Chrome trace of every frame, stage and counter
+//   --render METHOD       wire, wire-vertex, fill, fill-wire, textured (default),
+//                         textured-wire or overdraw
+//   --front-to-back       rasterize the triangles nearest first (see settings.h)
+//   --mesh FILE.obj       mesh to render
+//   --texture FILE        its texture, a .png or a baked .vtex
+//   --scene SPEC          generate a stress scene (see synthetic.h) instead, repeatable;
+//                         with --bench, the scenes benchmarked instead of the built-in ones
+//   --output FILE         stream the frames to FILE, "-" for stdout
+//   --output-format FMT   y4m (default) or ppm
+//   --bench               run the benchmark (see bench.h) and exit
+//   --bench-output FILE   write its JSON results to FILE instead of stdout
+//   --baseline FILE       results of an earlier run to compare with
+//   --threshold PERCENT   slowdown flagged as a regression, 5% by default
+//   --golden DIR          check the golden image cases (see golden.h) against DIR and exit
+//   --golden-update       write the cases' images to DIR as the new references instead
+//   --tolerance N         per channel color difference (out of 255) a golden check accepts
+//   --depth-tolerance F   depth difference (out of 1) a golden check accepts
+//   --job FILE            render a batch job (see job.h) and exit
+//   --shards N            pieces the job is split into, overriding the job file
+//   --threads N           threads the work is spread over (see scheduler.h), one per CPU if unset
+//   --pin-threads         tie every worker thread to a CPU of its own
+//   --bake-vtex IN OUT    bake a PNG into a virtual texture and exit
+////////////////////////////////////////////////////////////////////////////////
+
+#define OPTIONS_MAX_SCENES 64
+
+typedef struct {
+  bool headless;
+  int width;
+  int height;
+  int frames;
+  enum pacing_mode pacing;
+  bool pacing_given;
+  float fps;
+  const char *profile_file;
+  const char *trace_file;
+  enum render_method render_method;
+  bool front_to_back;
+  const char *mesh_file;
+  const char *texture_file;
+  synthetic_scene_t scenes[OPTIONS_MAX_SCENES];
+  int num_scenes;
+  const char *output_file;
+  enum video_format output_format;
+  bool bench;
+  const char *bench_output;
+  const char *baseline_file;
+  float threshold;
+  const char *golden_dir;
+  bool golden_update;
+  int tolerance;
+  float depth_tolerance;
+  const char *job_file;
+  int shards;
+  int threads;
+  bool pin_threads;
+  const char *bake_vtex_input;
+  const char *bake_vtex_output;
+} options_t;
+
+extern options_t options;
+
+bool parse_options(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,133 @@
+// nanosleep() is not part of C99.
+#define _POSIX_C_SOURCE 199309L
+
+#include "pacing.h"
+#include "clock.h"
+#include "profiler.h"
+#include "settings.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+frame_timing_t frame_timing = {0, 0, 0};
+
+static display_backend_t *backend = NULL;
+static bool vsync_enabled = false;
+
+static uint64_t frame_start = 0;
+static uint64_t deadline = 0;
+
+// Totals for the summary.
+static int frames = 0;
+static double total_cpu_time = 0;
+static double total_wait_time = 0;
+static float max_cpu_time = 0;
+
+void pacing_init(display_backend_t *display_backend) {
+  backend = display_backend;
+  vsync_enabled = false;
+  deadline = 0;
+}
+
+// Turn vsync on or off when pacing_mode has changed, falling back to a fixed rate without it.
+static void apply_pacing_mode(void) {
+  bool want_vsync = pacing_mode == PACING_VSYNC;
+  if (want_vsync == vsync_enabled) {
+    return;
+  }
+  if (backend->set_vsync(want_vsync)) {
+    vsync_enabled = want_vsync;
+  } else if (want_vsync) {
+    fprintf(stderr, "No vsync with the %s backend, pacing at a fixed rate.\n", backend->name);
+    pacing_mode = PACING_FIXED;
+  }
+}
+
+static void sleep_until(uint64_t time) {
+  uint64_t now = clock_ns();
+  if (time > now + PACING_SPIN_NS) {
+    uint64_t sleep = time - now - PACING_SPIN_NS;
+    struct timespec duration = {(time_t)(sleep / 1000000000), (long)(sleep % 1000000000)};
+    nanosleep(&duration, NULL);
+  }
+  while (clock_ns() < time) {
+#ifdef __SSE2__
+    _mm_pause();
+#endif
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Wait for the next slot of the fixed rate schedule. Frames that finish a
+// little late are presented right away and the schedule keeps its phase;
+// after falling more than a whole frame behind it restarts from now, rather
+// than rushing out frames to catch up.
+///////////////////////////////////////////////////////////////////////////////
+static void wait_for_deadline(void) {
+  uint64_t period = (uint64_t)(target_frame_time * 1e6);
+  uint64_t now = clock_ns();
+  if (deadline == 0 || now > deadline + period) {
+    deadline = now;
+  }
+  sleep_until(deadline);
+  deadline += period;
+}
+
+void pacing_begin_frame(void) {
+  uint64_t now = clock_ns();
+  if (frame_start != 0) {
+    frame_timing.frame_time = (now - frame_start) / 1e6;
+  }
+  frame_start = now;
+  apply_pacing_mode();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Present the frame started by pacing_begin_frame() once it is due. With
+// vsync the wait happens inside the backend's present, so all of it counts
+// as waiting.
+///////////////////////////////////////////////////////////////////////////////
+void pacing_present(void) {
+  uint64_t work_end = clock_ns();
+  if (pacing_mode == PACING_FIXED) {
+    wait_for_deadline();
+  } else {
+    deadline = 0;
+  }
+
+  uint64_t present_start = clock_ns();
+  backend->present();
+  uint64_t present_end = clock_ns();
+
+  if (profiling) {
+    profile_record(PROFILE_WAIT, work_end, present_start);
+    profile_record(PROFILE_PRESENT, present_start, present_end);
+  }
+
+  if (pacing_mode == PACING_VSYNC) {
+    frame_timing.cpu_time = (work_end - frame_start) / 1e6;
+    frame_timing.wait_time = (present_end - work_end) / 1e6;
+  } else {
+    frame_timing.cpu_time = ((work_end - frame_start) + (present_end - present_start)) / 1e6;
+    frame_timing.wait_time = (present_start - work_end) / 1e6;
+  }
+
+  frames++;
+  total_cpu_time += frame_timing.cpu_time;
+  total_wait_time += frame_timing.wait_time;
+  if (frame_timing.cpu_time > max_cpu_time) {
+    max_cpu_time = frame_timing.cpu_time;
+  }
+}
+
+void pacing_print_summary(void) {
+  if (frames == 0) {
+    return;
+  }
+  fprintf(stderr, "frame cpu time %.3f ms avg, %.3f ms max; wait time %.3f ms avg\n",
+          total_cpu_time / frames, max_cpu_time, total_wait_time / frames);
+}
@@ -0,0 +1,32 @@
+#ifndef PACING_H
+#define PACING_H
+
+#include "backend.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Frame pacing, replacing the old millisecond SDL_Delay() loop. Depending on
+// pacing_mode, frames are presented as soon as they are done, at a fixed
+// rate of target_frame_time (sleeping, then spinning on the monotonic clock
+// for the last stretch), or in step with the display's vsync.
+//
+// Every frame records the time spent working on it separately from the time
+// spent waiting, so the real cost of a frame is known even when capped.
+////////////////////////////////////////////////////////////////////////////////
+
+// Stop sleeping this long (in nanoseconds) before the deadline and spin instead, sleeps overshoot.
+#define PACING_SPIN_NS 1000000
+
+typedef struct {
+  float cpu_time;   // milliseconds of work: geometry, rasterization, copying to the backend
+  float wait_time;  // milliseconds spent sleeping, spinning or blocked on vsync
+  float frame_time; // milliseconds between the starts of the last two frames
+} frame_timing_t;
+
+extern frame_timing_t frame_timing;
+
+void pacing_init(display_backend_t *backend);
+void pacing_begin_frame(void);
+void pacing_present(void);
+void pacing_print_summary(void);
+
+#endif
@@ -0,0 +1,96 @@
+#include "pipeline.h"
+#include "context.h"
+#include "memory.h"
+#include "profiler.h"
+
+// Capture the settings a list is built with while the geometry stage is not running. The
+// triangles are allocated on first use, so without pipelining the second list never is, and
+// the buffers for sorting them once front to back order is first asked for.
+static void prepare_list(render_context_t *context, triangle_list_t *list) {
+  pipeline_t *pipeline = &context->pipeline;
+  if (list->triangles == NULL) {
+    list->triangles =
+        (triangle_t *)memory_alloc(MEMORY_FRAME, sizeof(triangle_t) * (size_t)pipeline->capacity);
+    list->capacity = list->triangles != NULL ? pipeline->capacity : 0;
+  }
+  list->frame = pipeline->next_frame++;
+  list->cull_method = context->settings.cull_method;
+  list->front_to_back = context->settings.front_to_back;
+  if (list->front_to_back && list->sorted == NULL && list->capacity > 0) {
+    list->sorted =
+        (triangle_t *)memory_alloc(MEMORY_FRAME, sizeof(triangle_t) * (size_t)list->capacity);
+    list->sort_keys = (float *)memory_alloc(MEMORY_FRAME, sizeof(float) * (size_t)list->capacity);
+  }
+  render_size_for_scale(context, context->settings.render_scale, &list->viewport_width,
+                        &list->viewport_height);
+}
+
+// Run the geometry stage on a list, timed for the profiler.
+static void build_list(render_context_t *context, triangle_list_t *list) {
+  uint64_t start = profile_begin();
+  context->pipeline.stage(context, list);
+  profile_end(PROFILE_GEOMETRY, start);
+}
+
+// The task building the back list. The list belongs to it until the task is waited for.
+static void build_back_list(void *data) {
+  render_context_t *context = (render_context_t *)data;
+  build_list(context, &context->pipeline.lists[1 - context->pipeline.front]);
+}
+
+void pipeline_init(render_context_t *context, geometry_stage_t geometry, int capacity) {
+  pipeline_t *pipeline = &context->pipeline;
+  pipeline->stage = geometry;
+  pipeline->front = 0;
+  pipeline->group.pending = 0;
+  pipeline->requested = false;
+  pipeline->next_frame = 0;
+  pipeline->capacity = capacity > 0 ? capacity : 1;
+}
+
+void pipeline_destroy(render_context_t *context) {
+  pipeline_t *pipeline = &context->pipeline;
+  task_wait(&pipeline->group);
+  pipeline->requested = false;
+
+  // Ready for another pipeline_init(), e.g. after loading a different scene.
+  for (int i = 0; i < 2; i++) {
+    memory_free(pipeline->lists[i].triangles);
+    memory_free(pipeline->lists[i].sorted);
+    memory_free(pipeline->lists[i].sort_keys);
+    pipeline->lists[i].triangles = NULL;
+    pipeline->lists[i].sorted = NULL;
+    pipeline->lists[i].sort_keys = NULL;
+    pipeline->lists[i].capacity = 0;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Return the triangles to rasterize this frame. If a task is building a list,
+// wait for it and hand it out; otherwise build one inline. Then, when
+// pipelining, submit the task for the following frame straight away.
+///////////////////////////////////////////////////////////////////////////////
+triangle_list_t *pipeline_next_frame(render_context_t *context) {
+  pipeline_t *pipeline = &context->pipeline;
+  uint64_t wait_start = profile_begin();
+  bool in_flight = pipeline->requested;
+  task_wait(&pipeline->group);
+  pipeline->requested = false;
+  profile_end(PROFILE_GEOMETRY_WAIT, wait_start);
+
+  if (in_flight) {
+    pipeline->front = 1 - pipeline->front;
+  } else {
+    prepare_list(context, &pipeline->lists[pipeline->front]);
+    build_list(context, &pipeline->lists[pipeline->front]);
+  }
+
+  if (context->settings.frame_pipelining) {
+    prepare_list(context, &pipeline->lists[1 - pipeline->front]);
+    pipeline->requested = true;
+    task_init(&pipeline->task, build_back_list, context, &pipeline->group);
+    task_submit(&pipeline->task);
+  }
+
+  return &pipeline->lists[pipeline->front];
+}
@@ -0,0 +1,38 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "scheduler.h"
+#include "triangle.h"
+
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Frame pipeline. With frame_pipelining on, the geometry of frame N+1 is built
+// by a task on the scheduler (see scheduler.h) while the calling thread
+// rasterizes and presents frame N, at the cost of one extra frame of latency.
+// The two stages ping-pong between a pair of triangle lists. With it off,
+// geometry runs inline as before.
+//
+// Every render context has its own pipeline. The lists hold capacity
+// triangles, normally count_mesh_faces() so a frame never drops any.
+////////////////////////////////////////////////////////////////////////////////
+
+typedef void (*geometry_stage_t)(render_context_t *context, triangle_list_t *triangles);
+
+typedef struct {
+  triangle_list_t lists[2];
+  int front; // the list being rasterized, the task builds the other one
+  geometry_stage_t stage;
+  task_t task;
+  task_group_t group;
+  bool requested; // a list has been handed to the task
+  int next_frame;
+  int capacity;
+} pipeline_t;
+
+void pipeline_init(render_context_t *context, geometry_stage_t geometry, int capacity);
+void pipeline_destroy(render_context_t *context);
+
+triangle_list_t *pipeline_next_frame(render_context_t *context);
+
+#endif
@@ -0,0 +1,349 @@
+#include "profiler.h"
+#include "array.h"
+#include "context.h"
+#include "display.h"
+#include "memory.h"
+#include "settings.h"
+#include "trace.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool profiling = false;
+bool profiler_hud = false;
+
+const char *profile_stage_names[NUM_PROFILE_STAGES] = {
+    "input", "geometry", "geometry_wait", "clear",   "raster",       "texture",
+    "hud",   "copy",     "wait",          "present", "load", "texture_load",
+};
+
+const char *profile_counter_names[NUM_PROFILE_COUNTERS] = {
+    "triangles_submitted",
+    "triangles_culled",
+    "triangles_frustum_culled",
+    "triangles_dropped",
+    "triangles_rasterized",
+    "pixels_tested",
+    "pixels_shaded",
+    "pixels_overwritten",
+    "memory_mesh",
+    "memory_texture",
+    "memory_framebuffer",
+    "memory_frame",
+    "memory_scratch",
+};
+
+static const color_t stage_colors[NUM_PROFILE_STAGES] = {
+    0xFF808080, // input
+    0xFF00C000, // geometry
+    0xFF004000, // geometry_wait
+    0xFFC08000, // clear
+    0xFF0000E0, // raster
+    0xFF00C0C0, // texture
+    0xFF606060, // hud
+    0xFFC000C0, // copy
+    0xFF302020, // wait
+    0xFFE0E0E0, // present
+    0xFF0080FF, // load
+    0xFF00FFFF, // texture_load
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Single producer, single consumer ring. The owning thread only moves head,
+// the main thread only moves tail, each publishing with a release store so
+// the other side sees complete events.
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+  profile_event_t events[PROFILER_RING_SIZE];
+  uint32_t head;
+  uint32_t tail;
+  uint32_t dropped;
+  const char *name;
+  int index; // doubles as the thread id in traces
+} profile_ring_t;
+
+static __thread profile_ring_t *thread_ring = NULL;
+static __thread const char *thread_name = "main";
+static __thread bool thread_ringless = false; // gave up on a ring, don't take the lock again
+
+static profile_ring_t *rings[PROFILER_MAX_THREADS];
+static int num_rings = 0;
+static pthread_mutex_t rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool warned_no_ring = false; // about a thread left without a ring, once
+
+static profile_frame_t *frames = NULL; // dynamic array, one entry per profiled frame
+static profile_frame_t current_frame;
+static uint64_t frame_start = 0;
+static int frame_number = 0;
+
+static int traced_rings = 0; // threads whose names are in the trace already
+
+// Find or make the calling thread's ring. Only the first event of a thread takes the lock.
+static profile_ring_t *get_thread_ring(void) {
+  if (thread_ring == NULL && !thread_ringless) {
+    pthread_mutex_lock(&rings_mutex);
+    if (num_rings < PROFILER_MAX_THREADS) {
+      thread_ring = (profile_ring_t *)memory_calloc(MEMORY_FRAME, 1, sizeof(profile_ring_t));
+    }
+    if (thread_ring != NULL) {
+      thread_ring->name = thread_name;
+      thread_ring->index = num_rings;
+      rings[num_rings] = thread_ring;
+      __atomic_store_n(&num_rings, num_rings + 1, __ATOMIC_RELEASE);
+    } else {
+      thread_ringless = true;
+      if (!warned_no_ring) {
+        fprintf(stderr, "Profiler: no room for thread %s, its events are dropped.\n",
+                thread_name);
+        warned_no_ring = true;
+      }
+    }
+    pthread_mutex_unlock(&rings_mutex);
+  }
+  return thread_ring;
+}
+
+// Name the calling thread in dumps. Doesn't allocate anything until the thread records an event.
+void profiler_thread_name(const char *name) {
+  thread_name = name;
+  if (thread_ring != NULL) {
+    thread_ring->name = name;
+  }
+}
+
+static void push_event(int stage, uint64_t start, uint64_t end, bool is_counter) {
+  profile_ring_t *ring = get_thread_ring();
+  if (ring == NULL) {
+    return;
+  }
+  uint32_t head = ring->head;
+  if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == PROFILER_RING_SIZE) {
+    ring->dropped++;
+    return;
+  }
+  profile_event_t *event = &ring->events[head & (PROFILER_RING_SIZE - 1)];
+  event->start = start;
+  event->end = end;
+  event->stage = stage;
+  event->is_counter = is_counter;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void profile_record(int stage, uint64_t start, uint64_t end) {
+  push_event(stage, start, end, false);
+}
+
+void profile_record_counter(int counter, uint64_t value) {
+  push_event(counter, clock_ns(), value, true);
+}
+
+static trace_record_t event_trace_record(const profile_ring_t *ring, const profile_event_t *event) {
+  trace_record_t record = {
+      .phase = event->is_counter ? 'C' : 'X',
+      .thread = ring->index,
+      .name = event->is_counter ? profile_counter_names[event->stage]
+                                : profile_stage_names[event->stage],
+      .start = event->start,
+      .value = event->is_counter ? event->end : event->end - event->start,
+      .frame = -1,
+  };
+  return record;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Close the frame: drain every thread's ring into the totals of this frame,
+// and into the trace when tracing. Events of the geometry thread count
+// towards the frame during which they ran, which with pipelining is the
+// frame before the one they build.
+///////////////////////////////////////////////////////////////////////////////
+void profiler_end_frame(void) {
+  uint64_t now = clock_ns();
+  trace_record_t records[64];
+  int num_records = 0;
+
+  int count = __atomic_load_n(&num_rings, __ATOMIC_ACQUIRE);
+  for (int i = 0; i < count; i++) {
+    profile_ring_t *ring = rings[i];
+    if (tracing && i >= traced_rings) {
+      trace_record_t name = {.phase = 'M', .thread = ring->index, .name = ring->name};
+      trace_push(&name, 1);
+      traced_rings = i + 1;
+    }
+
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    for (uint32_t tail = ring->tail; tail != head; tail++) {
+      profile_event_t *event = &ring->events[tail & (PROFILER_RING_SIZE - 1)];
+      if (event->is_counter) {
+        current_frame.counters[event->stage] = event->end;
+      } else {
+        current_frame.stages[event->stage] += (event->end - event->start) / 1e6;
+      }
+
+      if (tracing) {
+        records[num_records++] = event_trace_record(ring, event);
+        if (num_records == 64) {
+          trace_push(records, num_records);
+          num_records = 0;
+        }
+      }
+    }
+    __atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+  }
+
+  // A thread without a ring has no track in the trace to put its frames on.
+  profile_ring_t *main_ring = tracing && frame_start != 0 ? get_thread_ring() : NULL;
+  if (main_ring != NULL) {
+    trace_record_t frame = {
+        .phase = 'X',
+        .thread = main_ring->index,
+        .name = "frame",
+        .start = frame_start,
+        .value = now - frame_start,
+        .frame = frame_number,
+    };
+    records[num_records++] = frame;
+  }
+  if (num_records > 0) {
+    trace_push(records, num_records);
+  }
+
+  // The first frame after enabling has no start yet.
+  if (profiling && frame_start != 0) {
+    current_frame.frame_time = (now - frame_start) / 1e6;
+    if (array_length(frames) < PROFILER_MAX_FRAMES) {
+      array_push(frames, current_frame);
+    }
+    frame_number++;
+  }
+  memset(&current_frame, 0, sizeof(current_frame));
+  frame_start = profiling ? now : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Overlay with a stacked bar per recent frame, one color per stage, in the
+// bottom left corner. The line marks the target frame time; the box is twice
+// as tall.
+///////////////////////////////////////////////////////////////////////////////
+void profiler_draw_hud(render_context_t *context) {
+  uint64_t start = profile_begin();
+
+  int bar_width = 2;
+  int width = PROFILER_HUD_FRAMES * bar_width;
+  int height = 100;
+  int left = 10;
+  int bottom = context->render_height - 10;
+  float pixels_per_ms = height / (2 * target_frame_time);
+
+  draw_rect(context, left, bottom - height, width, height, 0xC0000000);
+
+  int num_frames = array_length(frames);
+  int first = num_frames > PROFILER_HUD_FRAMES ? num_frames - PROFILER_HUD_FRAMES : 0;
+  for (int i = first; i < num_frames; i++) {
+    int x = left + (i - first) * bar_width;
+    float y = bottom;
+    for (int stage = 0; stage < NUM_PROFILE_STAGES; stage++) {
+      float top = y - frames[i].stages[stage] * pixels_per_ms;
+      if (top < bottom - height) {
+        top = bottom - height;
+      }
+      if ((int)top < (int)y) {
+        draw_rect(context, x, (int)top, bar_width, (int)y - (int)top, stage_colors[stage]);
+      }
+      y = top;
+    }
+  }
+
+  int target_y = bottom - (int)(target_frame_time * pixels_per_ms);
+  draw_line(context, left, target_y, left + width - 1, target_y, 0xFFFFFFFF);
+
+  profile_end(PROFILE_HUD, start);
+}
+
+static bool dump_csv(FILE *file) {
+  fprintf(file, "frame,frame_ms");
+  for (int stage = 0; stage < NUM_PROFILE_STAGES; stage++) {
+    fprintf(file, ",%s_ms", profile_stage_names[stage]);
+  }
+  for (int counter = 0; counter < NUM_PROFILE_COUNTERS; counter++) {
+    fprintf(file, ",%s", profile_counter_names[counter]);
+  }
+  fprintf(file, "\n");
+
+  for (int i = 0; i < array_length(frames); i++) {
+    fprintf(file, "%d,%.4f", i, frames[i].frame_time);
+    for (int stage = 0; stage < NUM_PROFILE_STAGES; stage++) {
+      fprintf(file, ",%.4f", frames[i].stages[stage]);
+    }
+    for (int counter = 0; counter < NUM_PROFILE_COUNTERS; counter++) {
+      fprintf(file, ",%llu", (unsigned long long)frames[i].counters[counter]);
+    }
+    fprintf(file, "\n");
+  }
+  return true;
+}
+
+static bool dump_json(FILE *file) {
+  fprintf(file, "{\"stages\": [");
+  for (int stage = 0; stage < NUM_PROFILE_STAGES; stage++) {
+    fprintf(file, "%s\"%s\"", stage > 0 ? ", " : "", profile_stage_names[stage]);
+  }
+  fprintf(file, "],\n \"counters\": [");
+  for (int counter = 0; counter < NUM_PROFILE_COUNTERS; counter++) {
+    fprintf(file, "%s\"%s\"", counter > 0 ? ", " : "", profile_counter_names[counter]);
+  }
+  fprintf(file, "],\n \"frames\": [\n");
+
+  int num_frames = array_length(frames);
+  for (int i = 0; i < num_frames; i++) {
+    fprintf(file, "  {\"frame\": %d, \"frame_ms\": %.4f, \"stages_ms\": [", i,
+            frames[i].frame_time);
+    for (int stage = 0; stage < NUM_PROFILE_STAGES; stage++) {
+      fprintf(file, "%s%.4f", stage > 0 ? ", " : "", frames[i].stages[stage]);
+    }
+    fprintf(file, "], \"counters\": [");
+    for (int counter = 0; counter < NUM_PROFILE_COUNTERS; counter++) {
+      fprintf(file, "%s%llu", counter > 0 ? ", " : "",
+              (unsigned long long)frames[i].counters[counter]);
+    }
+    fprintf(file, "]}%s\n", i + 1 < num_frames ? "," : "");
+  }
+  fprintf(file, "]}\n");
+  return true;
+}
+
+// Write the per-frame stage timings as JSON when the file name ends in .json, CSV otherwise.
+bool profiler_dump(const char *filename) {
+  FILE *file = fopen(filename, "w");
+  if (file == NULL) {
+    fprintf(stderr, "Error opening %s.\n", filename);
+    return false;
+  }
+  const char *extension = strrchr(filename, '.');
+  if (extension != NULL && strcmp(extension, ".json") == 0) {
+    dump_json(file);
+  } else {
+    dump_csv(file);
+  }
+
+  for (int i = 0; i < num_rings; i++) {
+    if (rings[i]->dropped > 0) {
+      fprintf(stderr, "Profiler ring of the %s thread overflowed, %u events dropped.\n",
+              rings[i]->name, rings[i]->dropped);
+    }
+  }
+  return fclose(file) == 0;
+}
+
+// Call once every other thread that profiled has been joined.
+void profiler_free(void) {
+  array_free(frames);
+  frames = NULL;
+  for (int i = 0; i < num_rings; i++) {
+    memory_free(rings[i]);
+  }
+  num_rings = 0;
+  traced_rings = 0;
+  thread_ring = NULL;
+}
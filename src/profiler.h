@@ -0,0 +1,110 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "clock.h"
+#include "display.h"
+#include "scheduler.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Frame profiler. Stages are timed with a begin/end pair:
+//
+//   uint64_t start = profile_begin();
+//   ...
+//   profile_end(PROFILE_RASTER, start);
+//
+// Every thread records into its own ring of events, which only that thread
+// writes and the main thread drains once per frame, so recording never
+// takes a lock. With profiling off both calls reduce to a test of a global.
+//
+// Counters (profile_count()) go through the same rings.
+//
+// The per-frame totals can be shown as an overlay and dumped as CSV or JSON,
+// and the raw events can be streamed to a Chrome trace (see trace.h).
+////////////////////////////////////////////////////////////////////////////////
+
+#define PROFILER_RING_SIZE 4096 // events per thread, a power of two
+// The main thread and the scheduler's workers, plus texture loaders, the trace and video writers.
+#define PROFILER_MAX_THREADS (MAX_WORKERS + 8)
+#define PROFILER_MAX_FRAMES 100000 // frames kept for the dump
+#define PROFILER_HUD_FRAMES 120
+
+enum profile_stage {
+  PROFILE_INPUT,         // process_input()
+  PROFILE_GEOMETRY,      // render_geometry(), on whichever thread runs it
+  PROFILE_GEOMETRY_WAIT, // main thread waiting for the geometry thread
+  PROFILE_CLEAR,         // background and z-buffer clears
+  PROFILE_RASTER,        // the triangle loop
+  PROFILE_TEXTURE,       // texture_update(), virtual texture paging
+  PROFILE_HUD,           // drawing this overlay
+  PROFILE_COPY,          // render_color_buffer(): unlock, upscale, video output
+  PROFILE_WAIT,          // frame pacing
+  PROFILE_PRESENT,       // present_display()
+  PROFILE_LOAD,          // loading a mesh and its texture
+  PROFILE_TEXTURE_LOAD,  // paging in a virtual texture tile, on the loader thread
+  NUM_PROFILE_STAGES
+};
+
+enum profile_counter {
+  PROFILE_TRIANGLES_SUBMITTED,      // faces the meshes sent to the geometry stage
+  PROFILE_TRIANGLES_CULLED,         // ...rejected by backface culling
+  PROFILE_TRIANGLES_FRUSTUM_CULLED, // ...entirely outside the view frustum
+  PROFILE_TRIANGLES_DROPPED,        // ...over the triangle list's capacity
+  PROFILE_TRIANGLES_RASTERIZED,     // ...left for the rasterizer
+  PROFILE_PIXELS_TESTED,            // depth tests of the triangles' pixels
+  PROFILE_PIXELS_SHADED,            // ...passed and written
+  PROFILE_PIXELS_OVERWRITTEN,       // ...written and covered again later (see stats.h)
+  PROFILE_MEMORY_MESH,              // bytes allocated per category (see memory.h)
+  PROFILE_MEMORY_TEXTURE,
+  PROFILE_MEMORY_FRAMEBUFFER,
+  PROFILE_MEMORY_FRAME,
+  PROFILE_MEMORY_SCRATCH,
+  NUM_PROFILE_COUNTERS
+};
+
+typedef struct {
+  uint64_t start; // clock_ns() timestamps
+  uint64_t end;   // or the value, for counters
+  int stage;      // or the counter
+  bool is_counter;
+} profile_event_t;
+
+// Time spent in each stage during one frame, in milliseconds, and the last value of each counter.
+typedef struct {
+  float frame_time;
+  float stages[NUM_PROFILE_STAGES];
+  uint64_t counters[NUM_PROFILE_COUNTERS];
+} profile_frame_t;
+
+extern bool profiling;
+extern bool profiler_hud;
+
+extern const char *profile_stage_names[NUM_PROFILE_STAGES];
+extern const char *profile_counter_names[NUM_PROFILE_COUNTERS];
+
+void profile_record(int stage, uint64_t start, uint64_t end);
+void profile_record_counter(int counter, uint64_t value);
+
+static inline uint64_t profile_begin(void) { return profiling ? clock_ns() : 0; }
+
+static inline void profile_end(int stage, uint64_t start) {
+  if (start != 0) {
+    profile_record(stage, start, clock_ns());
+  }
+}
+
+static inline void profile_count(int counter, uint64_t value) {
+  if (profiling) {
+    profile_record_counter(counter, value);
+  }
+}
+
+void profiler_thread_name(const char *name);
+void profiler_end_frame(void);
+void profiler_draw_hud(render_context_t *context);
+bool profiler_dump(const char *filename);
+void profiler_free(void);
+
+#endif
@@ -0,0 +1,434 @@
+#include "render.h"
+#include "array.h"
+#include "background.h"
+#include "colors.h"
+#include "context.h"
+#include "memory.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "stats.h"
+
+#include <math.h>
+#include <string.h>
+
+// Faces of a mesh one geometry task projects.
+#define GEOMETRY_GRAIN 1024
+
+// Depth slices triangles are sorted into for front to back order.
+#define DEPTH_BUCKETS 1024
+
+///////////////////////////////////////////////////////////////////////////////
+// Trivial frustum reject: true when the three clip space points are all
+// outside the same plane of the view frustum, so none of the triangle can be
+// on screen. Triangles crossing the planes are still drawn.
+///////////////////////////////////////////////////////////////////////////////
+static bool outside_frustum(const vec4_t points[3]) {
+  int outside[6] = {0};
+  for (int i = 0; i < 3; i++) {
+    vec4_t p = points[i];
+    outside[0] += p.x < -p.w;
+    outside[1] += p.x > p.w;
+    outside[2] += p.y < -p.w;
+    outside[3] += p.y > p.w;
+    outside[4] += p.z < 0; // in front of the near plane
+    outside[5] += p.z > p.w;
+  }
+  for (int plane = 0; plane < 6; plane++) {
+    if (outside[plane] == 3) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// What projecting a run of faces produced.
+typedef struct {
+  int num_triangles;
+  int num_culled;
+  int num_frustum_culled;
+  int num_dropped;
+} face_counts_t;
+
+///////////////////////////////////////////////////////////////////////////////
+// Transform, cull and project the faces first..last-1 of a mesh into at most
+// room triangles packed from out on, with the settings of the list they are
+// for.
+///////////////////////////////////////////////////////////////////////////////
+static face_counts_t project_faces(render_context_t *context, mesh_t *mesh, mat4_t view_matrix,
+                                   const triangle_list_t *triangles_to_render, int first,
+                                   int last, triangle_t *out, int room) {
+  face_counts_t counts = {0};
+  mat4_t scale_matrix = mat4_make_scale(mesh->scale);
+  mat4_t translation_matrix = mat4_make_translation(mesh->translation);
+  mat4_t rotation_matrix_x = mat4_make_rotation_x(mesh->rotation.x);
+  mat4_t rotation_matrix_y = mat4_make_rotation_y(mesh->rotation.y);
+  mat4_t rotation_matrix_z = mat4_make_rotation_z(mesh->rotation.z);
+
+  for (int i = first; i < last; i++) {
+    face_t mesh_face = mesh->faces[i];
+
+    vec3_t face_vertices[3];
+    face_vertices[0] = mesh->vertices[mesh_face.a - 1];
+    face_vertices[1] = mesh->vertices[mesh_face.b - 1];
+    face_vertices[2] = mesh->vertices[mesh_face.c - 1];
+
+    vec4_t transformed_vertices[3];
+    for (int j = 0; j < 3; j++) {
+      vec4_t transformed_vertex = vec4_from_vec3(face_vertices[j]);
+
+      // Do some transformations...order matters!
+      // 1) Scale
+      // 2) Rotate
+      // 3) Translate
+      mat4_t world_matrix = mat4_identity();
+      world_matrix = mat4_mul_mat4(scale_matrix, world_matrix);
+      world_matrix = mat4_mul_mat4(rotation_matrix_z, world_matrix);
+      world_matrix = mat4_mul_mat4(rotation_matrix_y, world_matrix);
+      world_matrix = mat4_mul_mat4(rotation_matrix_x, world_matrix);
+      world_matrix = mat4_mul_mat4(translation_matrix, world_matrix);
+      world_matrix = mat4_mul_mat4(view_matrix, world_matrix);
+
+      transformed_vertex = mat4_mul_vec4(world_matrix, transformed_vertex);
+
+      transformed_vertices[j] = transformed_vertex;
+    }
+
+    // Get individual vectors from A, B, and C vertices to compute normal
+    vec3_t vector_a = vec3_from_vec4(transformed_vertices[0]); /*   A   */
+    vec3_t vector_b = vec3_from_vec4(transformed_vertices[1]); /*  / \  */
+    vec3_t vector_c = vec3_from_vec4(transformed_vertices[2]); /* C---B */
+
+    // Get the vector subtraction of B-A and C-A
+    vec3_t vector_ab = vec3_sub(vector_b, vector_a);
+    vec3_t vector_ac = vec3_sub(vector_c, vector_a);
+    vec3_normalize(&vector_ab);
+    vec3_normalize(&vector_ac);
+
+    vec3_t surface_normal = vec3_cross(vector_ab, vector_ac);
+    vec3_normalize(&surface_normal);
+    // The view matrix moved the camera to the origin.
+    vec3_t origin = {0, 0, 0};
+    vec3_t camera_ray = vec3_sub(origin, vector_a);
+
+    // Cull triangles that are not facing the camera.
+    if (triangles_to_render->cull_method == CULL_BACKFACE) {
+      if (vec3_dot(surface_normal, camera_ray) < 0) {
+        counts.num_culled++;
+        continue;
+      }
+    }
+
+    vec4_t projected_points[3];
+    for (int i = 0; i < 3; i++) {
+      projected_points[i] = mat4_mul_vec4(context->proj_matrix, transformed_vertices[i]);
+    }
+
+    if (outside_frustum(projected_points)) {
+      counts.num_frustum_culled++;
+      continue;
+    }
+
+    for (int i = 0; i < 3; i++) {
+      projected_points[i] = perspective_divide(projected_points[i]);
+
+      // Scale into the viewport.
+      projected_points[i].x *= (triangles_to_render->viewport_width / 2.0);
+      projected_points[i].y *= (triangles_to_render->viewport_height / 2.0);
+
+      // Invert the y values to account for flipped screen y coordinates.
+      projected_points[i].y *= -1;
+
+      // Translate the projected points to the middle of the screen.
+      projected_points[i].x += (triangles_to_render->viewport_width / 2.0);
+      projected_points[i].y += (triangles_to_render->viewport_height / 2.0);
+    }
+
+    float light_intensity_factor = -vec3_dot(surface_normal, context->light.direction);
+    color_t adjusted_color = light_apply_intensity(mesh_face.color, light_intensity_factor);
+    triangle_t projected_triangle = {
+        .points =
+            {
+                {
+                    projected_points[0].x,
+                    projected_points[0].y,
+                    projected_points[0].z,
+                    projected_points[0].w,
+                },
+                {
+                    projected_points[1].x,
+                    projected_points[1].y,
+                    projected_points[1].z,
+                    projected_points[1].w,
+                },
+                {
+                    projected_points[2].x,
+                    projected_points[2].y,
+                    projected_points[2].z,
+                    projected_points[2].w,
+                },
+            },
+        .texcoords =
+            {
+                mesh_face.a_uv,
+                mesh_face.b_uv,
+                mesh_face.c_uv,
+            },
+        .color = adjusted_color,
+        .texture = &mesh->texture,
+    };
+
+    if (counts.num_triangles < room) {
+      out[counts.num_triangles] = projected_triangle;
+      counts.num_triangles += 1;
+    } else {
+      counts.num_dropped++;
+    }
+  }
+  return counts;
+}
+
+// A mesh whose faces are projected in chunks of GEOMETRY_GRAIN, each into its own run of slots.
+typedef struct {
+  render_context_t *context;
+  mesh_t *mesh;
+  mat4_t view_matrix;
+  triangle_list_t *triangles_to_render;
+  face_counts_t *chunks;
+} mesh_chunks_t;
+
+static void project_chunk(void *data, int begin, int end) {
+  mesh_chunks_t *job = (mesh_chunks_t *)data;
+  triangle_list_t *list = job->triangles_to_render;
+  job->chunks[begin / GEOMETRY_GRAIN] =
+      project_faces(job->context, job->mesh, job->view_matrix, list, begin, end,
+                    &list->triangles[list->num_triangles + begin], end - begin);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Transform, cull and project the faces of a mesh into the list of triangles
+// to render. Big meshes are split over the scheduler's threads: every face
+// gets a slot in the list, and once all chunks are done their triangles are
+// packed behind each other in face order, exactly as if projected in one go.
+///////////////////////////////////////////////////////////////////////////////
+void project_mesh(render_context_t *context, mesh_t *mesh, mat4_t view_matrix,
+                  triangle_list_t *triangles_to_render) {
+  triangle_list_t *list = triangles_to_render;
+  int num_faces = array_length(mesh->faces);
+  int room = list->capacity - list->num_triangles;
+  face_counts_t counts = {0};
+
+  if (num_faces <= GEOMETRY_GRAIN || num_faces > room || scheduler_num_threads() == 1) {
+    counts = project_faces(context, mesh, view_matrix, list, 0, num_faces,
+                           &list->triangles[list->num_triangles], room);
+  } else {
+    int num_chunks = (num_faces + GEOMETRY_GRAIN - 1) / GEOMETRY_GRAIN;
+    mesh_chunks_t job = {
+        .context = context,
+        .mesh = mesh,
+        .view_matrix = view_matrix,
+        .triangles_to_render = list,
+        .chunks = (face_counts_t *)memory_alloc(MEMORY_FRAME, sizeof(face_counts_t) * num_chunks),
+    };
+    parallel_for(0, num_faces, GEOMETRY_GRAIN, project_chunk, &job);
+
+    for (int i = 0; i < num_chunks; i++) {
+      face_counts_t chunk = job.chunks[i];
+      memmove(&list->triangles[list->num_triangles + counts.num_triangles],
+              &list->triangles[list->num_triangles + i * GEOMETRY_GRAIN],
+              sizeof(triangle_t) * chunk.num_triangles);
+      counts.num_triangles += chunk.num_triangles;
+      counts.num_culled += chunk.num_culled;
+      counts.num_frustum_culled += chunk.num_frustum_culled;
+    }
+    memory_free(job.chunks);
+  }
+
+  list->num_triangles += counts.num_triangles;
+  list->num_culled += counts.num_culled;
+  list->num_frustum_culled += counts.num_frustum_culled;
+  list->num_dropped += counts.num_dropped;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Reorder the triangles roughly nearest first, so the depth test rejects the
+// pixels of most hidden ones before they are shaded. A counting sort into
+// depth slices between the nearest and farthest triangle, by the view depth
+// of each one's nearest corner, stable so triangles in the same slice keep
+// their mesh order.
+///////////////////////////////////////////////////////////////////////////////
+static void sort_front_to_back(triangle_list_t *list) {
+  int n = list->num_triangles;
+  if (n < 2 || list->sorted == NULL || list->sort_keys == NULL) {
+    return;
+  }
+
+  // perspective_divide() keeps the view depth in w.
+  float nearest = INFINITY;
+  float farthest = -INFINITY;
+  for (int i = 0; i < n; i++) {
+    const vec4_t *points = list->triangles[i].points;
+    float key = fminf(points[0].w, fminf(points[1].w, points[2].w));
+    list->sort_keys[i] = key;
+    nearest = fminf(nearest, key);
+    farthest = fmaxf(farthest, key);
+  }
+  float scale = farthest > nearest ? (DEPTH_BUCKETS - 1) / (farthest - nearest) : 0;
+
+  int starts[DEPTH_BUCKETS + 1] = {0};
+  for (int i = 0; i < n; i++) {
+    starts[(int)((list->sort_keys[i] - nearest) * scale) + 1]++;
+  }
+  for (int bucket = 1; bucket <= DEPTH_BUCKETS; bucket++) {
+    starts[bucket] += starts[bucket - 1];
+  }
+  for (int i = 0; i < n; i++) {
+    int bucket = (int)((list->sort_keys[i] - nearest) * scale);
+    list->sorted[starts[bucket]++] = list->triangles[i];
+  }
+
+  triangle_t *sorted = list->sorted;
+  list->sorted = list->triangles;
+  list->triangles = sorted;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Geometry stage: animate the meshes, then project them into the list of
+// triangles to render. With frame pipelining this runs as a task on one of
+// the scheduler's threads, so it and the animation must only touch the
+// meshes, the camera and the list it is given.
+///////////////////////////////////////////////////////////////////////////////
+void render_geometry(render_context_t *context, triangle_list_t *triangles_to_render) {
+  triangles_to_render->num_triangles = 0;
+  triangles_to_render->num_faces = 0;
+  triangles_to_render->num_culled = 0;
+  triangles_to_render->num_frustum_culled = 0;
+  triangles_to_render->num_dropped = 0;
+
+  if (context->animate != NULL) {
+    context->animate(context, triangles_to_render->frame);
+  }
+
+  vec3_t camera = context->camera_position;
+  vec3_t eye = {-camera.x, -camera.y, -camera.z};
+  mat4_t view_matrix = mat4_make_translation(eye);
+
+  for (int i = 0; i < context->mesh_count; i++) {
+    triangles_to_render->num_faces += array_length(context->meshes[i].faces);
+    project_mesh(context, &context->meshes[i], view_matrix, triangles_to_render);
+  }
+
+  if (triangles_to_render->front_to_back) {
+    sort_front_to_back(triangles_to_render);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Rasterize a list built by render_geometry() and hand the frame to the
+// output, ready for present_display().
+///////////////////////////////////////////////////////////////////////////////
+void render_frame(render_context_t *context, triangle_list_t *triangles_to_render) {
+  enum render_method render_method = context->settings.render_method;
+  render_stats_t *render_stats = &context->stats;
+
+  // Rasterize at the size the triangles were projected for, render_scale may have changed since.
+  set_render_size(context, triangles_to_render->viewport_width,
+                  triangles_to_render->viewport_height);
+
+  // Start the frame in the memory it will be presented from, clearing it first since a locked
+  // streaming texture holds garbage.
+  lock_color_buffer(context);
+  reset_render_stats(context);
+  render_stats->triangles_considered = triangles_to_render->num_faces;
+  render_stats->triangles_backface_culled = triangles_to_render->num_culled;
+  render_stats->triangles_frustum_culled = triangles_to_render->num_frustum_culled;
+  render_stats->triangles_dropped = triangles_to_render->num_dropped;
+  if (profiling || render_method == RENDER_OVERDRAW) {
+    begin_overdraw(context);
+  }
+
+  uint64_t start = profile_begin();
+  clear_to_background(context);
+  profile_end(PROFILE_CLEAR, start);
+
+  start = profile_begin();
+  for (int i = 0; i < triangles_to_render->num_triangles; i++) {
+    triangle_t t = triangles_to_render->triangles[i];
+    render_stats->triangles_rasterized++;
+
+    // Draw filled triangle
+    if (render_method == RENDER_FILL_TRIANGLE || render_method == RENDER_FILL_TRIANGLE_WIRE ||
+        render_method == RENDER_OVERDRAW) {
+      draw_filled_triangle(context,
+                           t.points[0].x, t.points[0].y, t.points[0].z, t.points[0].w, // vertex A
+                           t.points[1].x, t.points[1].y, t.points[1].z, t.points[1].w, // vertex B
+                           t.points[2].x, t.points[2].y, t.points[2].z, t.points[2].w, // vertex C
+                           t.color);
+    }
+
+    // Draw textured triangle
+    if (render_method == RENDER_TEXTURED || render_method == RENDER_TEXTURED_WIRE) {
+      draw_textured_triangle(
+          context, t.points[0].x, t.points[0].y, t.points[0].z, t.points[0].w, t.texcoords[0].u,
+          t.texcoords[0].v, // vertex A
+          t.points[1].x, t.points[1].y, t.points[1].z, t.points[1].w, t.texcoords[1].u,
+          t.texcoords[1].v, // vertex B
+          t.points[2].x, t.points[2].y, t.points[2].z, t.points[2].w, t.texcoords[2].u,
+          t.texcoords[2].v, // vertex C
+          t.texture);
+    }
+
+    // Draw triangle wireframe
+    if (render_method == RENDER_WIRE || render_method == RENDER_WIRE_VERTEX ||
+        render_method == RENDER_FILL_TRIANGLE_WIRE || render_method == RENDER_TEXTURED_WIRE) {
+      draw_triangle(context,
+                    t.points[0].x, t.points[0].y, // vertex A
+                    t.points[1].x, t.points[1].y, // vertex B
+                    t.points[2].x, t.points[2].y, // vertex C
+                    WHITE);
+    }
+
+    // Draw triangle vertex points
+    if (render_method == RENDER_WIRE_VERTEX) {
+      draw_rect(context, t.points[0].x - 3, t.points[0].y - 3, 6, 6, BLACK); // vertex A
+      draw_rect(context, t.points[1].x - 3, t.points[1].y - 3, 6, 6, BLACK); // vertex B
+      draw_rect(context, t.points[2].x - 3, t.points[2].y - 3, 6, 6, BLACK); // vertex C
+    }
+  }
+
+  end_overdraw(context);
+  if (render_method == RENDER_OVERDRAW) {
+    draw_overdraw_heatmap(context);
+  }
+
+  profile_end(PROFILE_RASTER, start);
+
+  profile_count(PROFILE_TRIANGLES_SUBMITTED, render_stats->triangles_considered);
+  profile_count(PROFILE_TRIANGLES_CULLED, render_stats->triangles_backface_culled);
+  profile_count(PROFILE_TRIANGLES_FRUSTUM_CULLED, render_stats->triangles_frustum_culled);
+  profile_count(PROFILE_TRIANGLES_DROPPED, render_stats->triangles_dropped);
+  profile_count(PROFILE_TRIANGLES_RASTERIZED, render_stats->triangles_rasterized);
+  profile_count(PROFILE_PIXELS_TESTED, render_stats->pixels_tested);
+  profile_count(PROFILE_PIXELS_SHADED, render_stats->pixels_shaded);
+  profile_count(PROFILE_PIXELS_OVERWRITTEN, render_stats->pixels_overwritten);
+  for (int i = 0; i < NUM_MEMORY_CATEGORIES; i++) {
+    profile_count(PROFILE_MEMORY_MESH + i, memory_usage(i).current);
+  }
+
+  start = profile_begin();
+  for (int i = 0; i < context->mesh_count; i++) {
+    texture_update(&context->meshes[i].texture);
+  }
+  profile_end(PROFILE_TEXTURE, start);
+
+  if (profiler_hud) {
+    profiler_draw_hud(context);
+  }
+
+  start = profile_begin();
+  finish_clear(context);
+  profile_end(PROFILE_CLEAR, start);
+
+  start = profile_begin();
+  render_color_buffer(context);
+  profile_end(PROFILE_COPY, start);
+}
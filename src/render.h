@@ -0,0 +1,24 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "display.h"
+#include "matrix.h"
+#include "mesh.h"
+#include "triangle.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// The two stages of a frame of a render context. render_geometry() is the
+// pipeline's geometry stage, see pipeline.h:
+//
+//   pipeline_init(context, render_geometry, count_mesh_faces(context));
+//   ...
+//   render_frame(context, pipeline_next_frame(context));
+//   present_display(context);
+////////////////////////////////////////////////////////////////////////////////
+
+void project_mesh(render_context_t *context, mesh_t *mesh, mat4_t view_matrix,
+                  triangle_list_t *triangles_to_render);
+void render_geometry(render_context_t *context, triangle_list_t *triangles_to_render);
+void render_frame(render_context_t *context, triangle_list_t *triangles_to_render);
+
+#endif
@@ -0,0 +1,135 @@
+#include "renderer.h"
+#include "context.h"
+#include "memory.h"
+#include "render.h"
+#include "scheduler.h"
+
+#include <string.h>
+
+#define MESH_DISTANCE 5.0 // where meshes start in front of the camera, as in the viewer
+
+// A render context that starts its pipeline once the scene is there to size it.
+struct renderer {
+  render_context_t context;
+  bool pipeline_running; // sized for the meshes loaded so far
+};
+
+static vec3_t to_vec3(renderer_vec3_t v) { return (vec3_t){v.x, v.y, v.z}; }
+
+// The triangle lists hold as many triangles as the scene has faces, so they are rebuilt when the
+// scene changes.
+static void stop_pipeline(renderer_t *renderer) {
+  if (renderer->pipeline_running) {
+    pipeline_destroy(&renderer->context);
+    renderer->pipeline_running = false;
+  }
+}
+
+bool renderer_start_threads(int num_threads, bool pin_threads) {
+  return scheduler_init(num_threads, pin_threads);
+}
+
+void renderer_stop_threads(void) { scheduler_shutdown(); }
+
+renderer_t *renderer_create(int width, int height) {
+  // The context is mostly the table of its meshes.
+  renderer_t *renderer = (renderer_t *)memory_calloc(MEMORY_MESH, 1, sizeof(renderer_t));
+  if (renderer == NULL) {
+    return NULL;
+  }
+  if (!render_context_init(&renderer->context, NULL, width, height)) {
+    memory_free(renderer);
+    return NULL;
+  }
+  return renderer;
+}
+
+void renderer_destroy(renderer_t *renderer) {
+  stop_pipeline(renderer);
+  render_context_destroy(&renderer->context);
+  memory_free(renderer);
+}
+
+int renderer_load_mesh(renderer_t *renderer, const char *obj_filename,
+                       const char *texture_filename) {
+  vec3_t scale = {1.0, 1.0, 1.0};
+  vec3_t rotation = {0, 0, 0};
+  vec3_t translation = {0, 0, MESH_DISTANCE};
+  stop_pipeline(renderer);
+  if (!load_mesh(&renderer->context, obj_filename, texture_filename, scale, rotation,
+                 translation)) {
+    return -1;
+  }
+  return renderer->context.mesh_count - 1;
+}
+
+int renderer_load_mesh_memory(renderer_t *renderer, const char *obj_data, size_t obj_size,
+                              const unsigned char *png_data, size_t png_size) {
+  vec3_t scale = {1.0, 1.0, 1.0};
+  vec3_t rotation = {0, 0, 0};
+  vec3_t translation = {0, 0, MESH_DISTANCE};
+  stop_pipeline(renderer);
+  if (!load_mesh_data(&renderer->context, obj_data, obj_size, png_data, png_size, scale,
+                      rotation, translation)) {
+    return -1;
+  }
+  return renderer->context.mesh_count - 1;
+}
+
+void renderer_clear_meshes(renderer_t *renderer) {
+  stop_pipeline(renderer);
+  free_meshes(&renderer->context);
+}
+
+bool renderer_set_transform(renderer_t *renderer, int mesh, renderer_vec3_t scale,
+                            renderer_vec3_t rotation, renderer_vec3_t translation) {
+  if (mesh < 0 || mesh >= renderer->context.mesh_count) {
+    return false;
+  }
+  renderer->context.meshes[mesh].scale = to_vec3(scale);
+  renderer->context.meshes[mesh].rotation = to_vec3(rotation);
+  renderer->context.meshes[mesh].translation = to_vec3(translation);
+  return true;
+}
+
+void renderer_set_camera(renderer_t *renderer, renderer_vec3_t position) {
+  renderer->context.camera_position = to_vec3(position);
+}
+
+void renderer_set_background(renderer_t *renderer, uint32_t color) {
+  renderer->context.background.type = BACKGROUND_SOLID;
+  renderer->context.background.color = color;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Build and rasterize a frame of the scene as it is now. Without frame
+// pipelining the geometry is built on this thread, so the transforms set
+// before the call are the ones drawn.
+///////////////////////////////////////////////////////////////////////////////
+bool renderer_render_frame(renderer_t *renderer, uint32_t *pixels, int stride) {
+  render_context_t *context = &renderer->context;
+  if (pixels == NULL || stride < context->window_width) {
+    return false;
+  }
+  if (!renderer->pipeline_running) {
+    pipeline_init(context, render_geometry, count_mesh_faces(context));
+    renderer->pipeline_running = true;
+  }
+
+  display_set_target(context, pixels, stride);
+  render_frame(context, pipeline_next_frame(context));
+  display_set_target(context, NULL, 0);
+  return true;
+}
+
+bool renderer_read_depth(const renderer_t *renderer, float *depth, int stride) {
+  const render_context_t *context = &renderer->context;
+  if (depth == NULL || stride < context->render_width) {
+    return false;
+  }
+  for (int y = 0; y < context->render_height; y++) {
+    memcpy(&depth[(size_t)stride * y], &context->z_buffer[context->render_width * y],
+           sizeof(float) * context->render_width);
+  }
+  return true;
+}
@@ -0,0 +1,63 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// The renderer as a library, for programs that render in-process instead of
+// running the viewer. `make lib` builds it into librenderer.a and
+// librenderer.so, and this is the only header they need:
+//
+//   renderer_t *renderer = renderer_create(256, 256);
+//   int mesh = renderer_load_mesh(renderer, "cube.obj", "cube.png");
+//   renderer_set_transform(renderer, mesh, scale, rotation, translation);
+//   uint32_t *pixels = malloc(sizeof(uint32_t) * 256 * 256);
+//   renderer_render_frame(renderer, pixels, 256);
+//   renderer_destroy(renderer);
+//
+// Pixels are RGBA32: the bytes R, G, B, A in memory, so 0xAABBGGRR as a
+// uint32_t on little-endian machines, background colors included. A renderer
+// is not shared with anything, so any number of them can render at the same
+// time on different threads, as long as each one is only used by one thread
+// at a time. Errors are reported on stderr.
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct renderer renderer_t;
+
+// Spread the work of big meshes over num_threads threads in all, one per CPU when 0, shared by
+// every renderer of the process. Without it each renderer works on the calling thread only.
+// Stop them once no renderer is rendering anymore.
+bool renderer_start_threads(int num_threads, bool pin_threads);
+void renderer_stop_threads(void);
+
+typedef struct {
+  float x, y, z;
+} renderer_vec3_t;
+
+// Frames of width x height pixels, over the grid background. NULL if out of memory.
+renderer_t *renderer_create(int width, int height);
+void renderer_destroy(renderer_t *renderer);
+
+// Add a mesh with a PNG texture (or a baked .vtex file), returning its index or -1. Meshes start
+// unrotated at scale 1, 5 units in front of the camera.
+int renderer_load_mesh(renderer_t *renderer, const char *obj_filename,
+                       const char *texture_filename);
+int renderer_load_mesh_memory(renderer_t *renderer, const char *obj_data, size_t obj_size,
+                              const unsigned char *png_data, size_t png_size);
+void renderer_clear_meshes(renderer_t *renderer);
+
+// Meshes are scaled, rotated around z, then y, then x (in radians) and then translated.
+bool renderer_set_transform(renderer_t *renderer, int mesh, renderer_vec3_t scale,
+                            renderer_vec3_t rotation, renderer_vec3_t translation);
+// The camera always looks down the z axis, with y up.
+void renderer_set_camera(renderer_t *renderer, renderer_vec3_t position);
+void renderer_set_background(renderer_t *renderer, uint32_t color);
+
+// Render a frame straight into the caller's pixels, rows of stride pixels apart.
+bool renderer_render_frame(renderer_t *renderer, uint32_t *pixels, int stride);
+// Copy out the depths of the last frame, 1 - 1/z of the nearest surface and 1 where nothing is.
+bool renderer_read_depth(const renderer_t *renderer, float *depth, int stride);
+
+#endif
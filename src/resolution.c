@@ -0,0 +1,42 @@
+#include "resolution.h"
+#include "context.h"
+
+// Frames to wait after a change before judging its effect.
+#define RESOLUTION_COOLDOWN_FRAMES 15
+
+///////////////////////////////////////////////////////////////////////////////
+// Dynamic resolution controller. Keeps a moving average of the frame time (in
+// milliseconds, without the time spent waiting for the next frame) and moves
+// the context's render_scale one step down when frames run over the target,
+// or one step up when there is clearly room to spare. Steps are coarse and
+// spaced out, so the render size doesn't change every frame.
+///////////////////////////////////////////////////////////////////////////////
+void update_dynamic_resolution(render_context_t *context, float frame_time) {
+  dynamic_resolution_t *state = &context->dynamic_resolution;
+  render_settings_t *settings = &context->settings;
+  state->average_frame_time = state->average_frame_time == 0
+                                  ? frame_time
+                                  : state->average_frame_time * 0.9 + frame_time * 0.1;
+  if (!settings->dynamic_resolution) {
+    return;
+  }
+  if (state->cooldown > 0) {
+    state->cooldown--;
+    return;
+  }
+
+  if (state->average_frame_time > target_frame_time * 1.05 &&
+      settings->render_scale > MIN_RENDER_SCALE) {
+    settings->render_scale -= RENDER_SCALE_STEP;
+    if (settings->render_scale < MIN_RENDER_SCALE) {
+      settings->render_scale = MIN_RENDER_SCALE;
+    }
+    state->cooldown = RESOLUTION_COOLDOWN_FRAMES;
+  } else if (state->average_frame_time < target_frame_time * 0.8 && settings->render_scale < 1.0) {
+    settings->render_scale += RENDER_SCALE_STEP;
+    if (settings->render_scale > 1.0) {
+      settings->render_scale = 1.0;
+    }
+    state->cooldown = RESOLUTION_COOLDOWN_FRAMES;
+  }
+}
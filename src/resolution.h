@@ -0,0 +1,16 @@
+#ifndef RESOLUTION_H
+#define RESOLUTION_H
+
+#include "display.h"
+
+#define MIN_RENDER_SCALE 0.25
+#define RENDER_SCALE_STEP 0.05
+
+typedef struct {
+  float average_frame_time;
+  int cooldown;
+} dynamic_resolution_t;
+
+void update_dynamic_resolution(render_context_t *context, float frame_time);
+
+#endif
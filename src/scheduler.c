@@ -0,0 +1,368 @@
+// sysconf() and sched_yield() are POSIX, pthread_setaffinity_np() a GNU extension.
+#define _GNU_SOURCE
+
+#include "scheduler.h"
+#include "memory.h"
+#include "profiler.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+// Tasks one deque holds; submitting to a full one runs the task straight away instead.
+#define DEQUE_SIZE 1024
+#define DEQUE_MASK (DEQUE_SIZE - 1)
+
+////////////////////////////////////////////////////////////////////////////////
+// A ring of tasks. The owning worker pushes and pops at the bottom, so it
+// works through its most recent, cache-warm tasks first, while thieves take
+// the oldest ones from the top, which tend to be the biggest pieces of work.
+// Tasks are coarse enough for a lock per deque.
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+  pthread_mutex_t mutex;
+  unsigned top;    // next task to steal
+  unsigned bottom; // next free slot
+  task_t *tasks[DEQUE_SIZE];
+} deque_t;
+
+typedef struct {
+  pthread_t thread;
+  deque_t deque;
+  char name[16]; // for the profiler
+} worker_t;
+
+static worker_t workers[MAX_WORKERS];
+static int num_workers = 0;
+static deque_t shared_deque = {.mutex = PTHREAD_MUTEX_INITIALIZER};
+
+// Idle workers and waiters sleep on wake until there is work or their group is done. queued is
+// raised before a task is pushed and lowered once it is taken, so it is never below the number
+// of queued tasks.
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static int queued = 0;
+static int sleeping = 0;
+static bool quit = false;
+
+static __thread int worker_index = -1; // -1 on threads that are not workers
+
+static bool deque_push(deque_t *deque, task_t *task) {
+  pthread_mutex_lock(&deque->mutex);
+  bool pushed = deque->bottom - deque->top < DEQUE_SIZE;
+  if (pushed) {
+    deque->tasks[deque->bottom++ & DEQUE_MASK] = task;
+  }
+  pthread_mutex_unlock(&deque->mutex);
+  return pushed;
+}
+
+static task_t *deque_pop(deque_t *deque) {
+  task_t *task = NULL;
+  pthread_mutex_lock(&deque->mutex);
+  if (deque->bottom != deque->top) {
+    task = deque->tasks[--deque->bottom & DEQUE_MASK];
+  }
+  pthread_mutex_unlock(&deque->mutex);
+  return task;
+}
+
+static task_t *deque_steal(deque_t *deque) {
+  task_t *task = NULL;
+  pthread_mutex_lock(&deque->mutex);
+  if (deque->bottom != deque->top) {
+    task = deque->tasks[deque->top++ & DEQUE_MASK];
+  }
+  pthread_mutex_unlock(&deque->mutex);
+  return task;
+}
+
+// Wake every sleeper to look for work or at its group again. Sleepers register under the mutex
+// before checking, so one that has not registered yet is bound to see the change.
+static void wake_sleepers(void) {
+  if (__atomic_load_n(&sleeping, __ATOMIC_SEQ_CST) > 0) {
+    pthread_mutex_lock(&mutex);
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&mutex);
+  }
+}
+
+// Take the next task: the newest of our own, or else the oldest of another deque, starting with
+// our neighbour so the thieves spread out.
+static task_t *find_task(void) {
+  task_t *task = NULL;
+  if (worker_index >= 0) {
+    task = deque_pop(&workers[worker_index].deque);
+  }
+  int num_deques = num_workers + 1; // the last one is the shared deque
+  int first = worker_index >= 0 ? worker_index + 1 : num_workers;
+  for (int i = 0; task == NULL && i < num_deques; i++) {
+    int victim = (first + i) % num_deques;
+    task = deque_steal(victim < num_workers ? &workers[victim].deque : &shared_deque);
+  }
+  if (task != NULL) {
+    __atomic_sub_fetch(&queued, 1, __ATOMIC_SEQ_CST);
+  }
+  return task;
+}
+
+static void run_task(task_t *task);
+
+static void push_task(task_t *task) {
+  deque_t *deque = worker_index >= 0 ? &workers[worker_index].deque : &shared_deque;
+  __atomic_add_fetch(&queued, 1, __ATOMIC_SEQ_CST);
+  if (!deque_push(deque, task)) {
+    __atomic_sub_fetch(&queued, 1, __ATOMIC_SEQ_CST);
+    run_task(task);
+    return;
+  }
+  wake_sleepers();
+}
+
+static void lock_task(task_t *task) {
+  while (__atomic_exchange_n(&task->lock, 1, __ATOMIC_ACQUIRE)) {
+    sched_yield();
+  }
+}
+
+static void unlock_task(task_t *task) { __atomic_store_n(&task->lock, 0, __ATOMIC_RELEASE); }
+
+// Count off one of the things a task waits for, queueing it after the last one.
+static void release_task(task_t *task) {
+  if (__atomic_sub_fetch(&task->unfinished, 1, __ATOMIC_ACQ_REL) == 0) {
+    push_task(task);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Run a task, then release its successors and count it off its group. Once
+// the group is down to 0 its waiter may free the task, so nothing of it is
+// touched after that.
+///////////////////////////////////////////////////////////////////////////////
+static void run_task(task_t *task) {
+  task->function(task->data);
+
+  task_t *successors[MAX_TASK_SUCCESSORS];
+  lock_task(task);
+  task->done = true;
+  int num_successors = task->num_successors;
+  for (int i = 0; i < num_successors; i++) {
+    successors[i] = task->successors[i];
+  }
+  task_group_t *group = task->group;
+  unlock_task(task);
+
+  for (int i = 0; i < num_successors; i++) {
+    release_task(successors[i]);
+  }
+  if (__atomic_sub_fetch(&group->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+    wake_sleepers();
+  }
+}
+
+static void *worker_main(void *arg) {
+  worker_index = (int)(intptr_t)arg;
+  profiler_thread_name(workers[worker_index].name);
+  while (true) {
+    task_t *task = find_task();
+    if (task != NULL) {
+      run_task(task);
+      continue;
+    }
+
+    pthread_mutex_lock(&mutex);
+    __atomic_add_fetch(&sleeping, 1, __ATOMIC_SEQ_CST);
+    while (!quit && __atomic_load_n(&queued, __ATOMIC_SEQ_CST) == 0) {
+      pthread_cond_wait(&wake, &mutex);
+    }
+    __atomic_sub_fetch(&sleeping, 1, __ATOMIC_SEQ_CST);
+    bool done = quit;
+    pthread_mutex_unlock(&mutex);
+    if (done) {
+      return NULL;
+    }
+  }
+}
+
+#ifdef __linux__
+static void pin_thread(pthread_t thread, int cpu) {
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  if (pthread_setaffinity_np(thread, sizeof(cpus), &cpus) != 0) {
+    fprintf(stderr, "Could not pin a worker thread to CPU %d.\n", cpu);
+  }
+}
+#else
+static void pin_thread(pthread_t thread, int cpu) {
+  (void)thread;
+  fprintf(stderr, "Pinning threads is not supported here, CPU %d left unpinned.\n", cpu);
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Start num_threads - 1 workers; the calling thread, and any other, helps
+// whenever it waits. Pinned workers get CPUs 1, 2, ... leaving the first one
+// to the main thread.
+///////////////////////////////////////////////////////////////////////////////
+bool scheduler_init(int num_threads, bool pin_threads) {
+  int num_cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (num_cpus < 1) {
+    num_cpus = 1;
+  }
+  if (num_threads <= 0) {
+    num_threads = num_cpus;
+  }
+  int wanted = num_threads - 1 < MAX_WORKERS ? num_threads - 1 : MAX_WORKERS;
+
+  quit = false;
+  for (int i = 0; i < wanted; i++) {
+    worker_t *worker = &workers[i];
+    pthread_mutex_init(&worker->deque.mutex, NULL);
+    worker->deque.top = 0;
+    worker->deque.bottom = 0;
+    snprintf(worker->name, sizeof(worker->name), "worker %d", i + 1);
+  }
+  // Workers steal from each other, so they are all counted before the first one starts.
+  num_workers = wanted;
+  for (int i = 0; i < wanted; i++) {
+    if (pthread_create(&workers[i].thread, NULL, worker_main, (void *)(intptr_t)i) != 0) {
+      fprintf(stderr, "Error starting worker thread %d.\n", i + 1);
+      num_workers = i;
+      scheduler_shutdown();
+      return false;
+    }
+    if (pin_threads) {
+      pin_thread(workers[i].thread, (i + 1) % num_cpus);
+    }
+  }
+  return true;
+}
+
+// Stop the workers. Every task must have been waited for.
+void scheduler_shutdown(void) {
+  pthread_mutex_lock(&mutex);
+  quit = true;
+  pthread_cond_broadcast(&wake);
+  pthread_mutex_unlock(&mutex);
+  for (int i = 0; i < num_workers; i++) {
+    pthread_join(workers[i].thread, NULL);
+    pthread_mutex_destroy(&workers[i].deque.mutex);
+  }
+  num_workers = 0;
+}
+
+// Threads tasks run on, the workers and one waiting thread.
+int scheduler_num_threads(void) { return num_workers + 1; }
+
+void task_init(task_t *task, task_function_t function, void *data, task_group_t *group) {
+  task->function = function;
+  task->data = data;
+  task->group = group;
+  task->unfinished = 1;
+  task->lock = 0;
+  task->done = false;
+  task->num_successors = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Hold task back until before is done; before may already be running, or
+// done, in which case there is nothing to wait for. Must be called before
+// task is submitted. False if before has no room for another successor.
+///////////////////////////////////////////////////////////////////////////////
+bool task_depends_on(task_t *task, task_t *before) {
+  bool added = true;
+  lock_task(before);
+  if (!before->done) {
+    if (before->num_successors == MAX_TASK_SUCCESSORS) {
+      added = false;
+    } else {
+      before->successors[before->num_successors++] = task;
+      __atomic_add_fetch(&task->unfinished, 1, __ATOMIC_ACQ_REL);
+    }
+  }
+  unlock_task(before);
+  return added;
+}
+
+// Queue the task, or once its dependencies are done if they are not yet.
+void task_submit(task_t *task) {
+  __atomic_add_fetch(&task->group->pending, 1, __ATOMIC_SEQ_CST);
+  release_task(task);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Return once every task submitted to the group is done, running queued tasks
+// of any group in the meantime. Only sleeps when there is nothing to run.
+///////////////////////////////////////////////////////////////////////////////
+void task_wait(task_group_t *group) {
+  while (__atomic_load_n(&group->pending, __ATOMIC_ACQUIRE) > 0) {
+    task_t *task = find_task();
+    if (task != NULL) {
+      run_task(task);
+      continue;
+    }
+
+    pthread_mutex_lock(&mutex);
+    __atomic_add_fetch(&sleeping, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&group->pending, __ATOMIC_SEQ_CST) > 0 &&
+           __atomic_load_n(&queued, __ATOMIC_SEQ_CST) == 0) {
+      pthread_cond_wait(&wake, &mutex);
+    }
+    __atomic_sub_fetch(&sleeping, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&mutex);
+  }
+}
+
+typedef struct {
+  task_t task;
+  range_function_t function;
+  void *data;
+  int begin;
+  int end;
+} range_chunk_t;
+
+static void run_chunk(void *data) {
+  range_chunk_t *chunk = (range_chunk_t *)data;
+  chunk->function(chunk->data, chunk->begin, chunk->end);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Split begin..end-1 into chunks of grain indices and run them as tasks, the
+// first one on the calling thread, which then helps with the rest. Without a
+// grain every thread gets about 4 chunks, to even out uneven ones. A single
+// chunk, or no workers to share it with, runs as one plain call.
+///////////////////////////////////////////////////////////////////////////////
+void parallel_for(int begin, int end, int grain, range_function_t function, void *data) {
+  int count = end - begin;
+  if (count <= 0) {
+    return;
+  }
+  if (grain <= 0) {
+    int chunks = scheduler_num_threads() * 4;
+    grain = (count + chunks - 1) / chunks;
+  }
+  int num_chunks = (count + grain - 1) / grain;
+  if (num_chunks == 1 || num_workers == 0) {
+    function(data, begin, end);
+    return;
+  }
+
+  range_chunk_t *chunks =
+      (range_chunk_t *)memory_alloc(MEMORY_FRAME, sizeof(range_chunk_t) * num_chunks);
+  task_group_t group = {0};
+  for (int i = num_chunks - 1; i > 0; i--) {
+    range_chunk_t *chunk = &chunks[i];
+    chunk->function = function;
+    chunk->data = data;
+    chunk->begin = begin + i * grain;
+    chunk->end = chunk->begin + grain < end ? chunk->begin + grain : end;
+    task_init(&chunk->task, run_chunk, chunk, &group);
+    task_submit(&chunk->task);
+  }
+  function(data, begin, begin + grain);
+  task_wait(&group);
+  memory_free(chunks);
+}
@@ -0,0 +1,67 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// The worker pool every parallel part of the renderer runs on, shared by the
+// whole process so they never start threads of their own and oversubscribe
+// the CPUs. Every worker has a deque of tasks: it pushes and pops its own
+// work at the bottom and, once it runs out, steals from the top of the
+// others'. Tasks submitted from any other thread go to a shared deque the
+// workers steal from as well.
+//
+// A thread waiting for tasks runs queued ones until they are done, so waits
+// can nest and never leave a CPU idle while there is work. Without workers
+// (1 thread, or before scheduler_init()) tasks run on the thread that waits
+// for them, so the code using the scheduler needs no serial fallback.
+//
+//   task_group_t frame = {0};
+//   task_t build, draw;
+//   task_init(&build, build_geometry, context, &frame);
+//   task_init(&draw, rasterize, context, &frame);
+//   task_depends_on(&draw, &build); // draw is queued once build is done
+//   task_submit(&draw);
+//   task_submit(&build);
+//   task_wait(&frame);
+//
+// Tasks and groups belong to the caller and must stay alive until the wait for
+// their group returns.
+////////////////////////////////////////////////////////////////////////////////
+
+#define MAX_WORKERS 64
+#define MAX_TASK_SUCCESSORS 8
+
+typedef void (*task_function_t)(void *data);
+typedef void (*range_function_t)(void *data, int begin, int end);
+
+typedef struct {
+  int pending; // tasks submitted and not finished yet
+} task_group_t;
+
+typedef struct task {
+  task_function_t function;
+  void *data;
+  task_group_t *group;
+  int unfinished; // dependencies not done yet, plus one until submitted
+  int lock;       // guards done and successors
+  bool done;
+  int num_successors;
+  struct task *successors[MAX_TASK_SUCCESSORS]; // queued once this task is done
+} task_t;
+
+// Start the pool for num_threads threads in all, counting the calling one; one per CPU when 0.
+// Pinning ties every worker to a CPU of its own.
+bool scheduler_init(int num_threads, bool pin_threads);
+void scheduler_shutdown(void);
+int scheduler_num_threads(void);
+
+void task_init(task_t *task, task_function_t function, void *data, task_group_t *group);
+bool task_depends_on(task_t *task, task_t *before);
+void task_submit(task_t *task);
+void task_wait(task_group_t *group);
+
+// Call function on chunks of grain indices of begin..end-1 in parallel, 0 picks the grain.
+void parallel_for(int begin, int end, int grain, range_function_t function, void *data);
+
+#endif
@@ -0,0 +1,18 @@
+#include "settings.h"
+
+const render_settings_t default_render_settings = {
+    .render_method = RENDER_TEXTURED,
+    .cull_method = CULL_BACKFACE,
+    .texture_filter = FILTER_MIPMAP,
+    .texture_layout = TEXTURE_LAYOUT_TILED,
+    .front_to_back = false,
+    .frame_pipelining = false,
+    .render_scale = 1.0,
+    .upscale_filter = UPSCALE_BILINEAR,
+    .dynamic_resolution = false,
+    .lazy_clear = true,
+    .zero_copy_present = true,
+};
+
+float target_frame_time = 1000.0 / 60;
+enum pacing_mode pacing_mode = PACING_FIXED;
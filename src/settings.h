@@ -1,7 +1,9 @@
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
-enum cull_method { CULL_NONE, CULL_BACKFACE } cull_method;
+#include <stdbool.h>
+
+enum cull_method { CULL_NONE, CULL_BACKFACE };
 
 enum render_method {
   RENDER_WIRE,
@@ -10,6 +12,68 @@ enum render_method {
   RENDER_FILL_TRIANGLE_WIRE,
   RENDER_TEXTURED,
   RENDER_TEXTURED_WIRE,
-} render_method;
+  RENDER_OVERDRAW, // heatmap of how many times each pixel was shaded
+};
+
+enum texture_filter {
+  FILTER_NEAREST,   // always sample the full resolution texture
+  FILTER_MIPMAP,    // nearest mip level per triangle
+  FILTER_TRILINEAR, // blend the two closest mip levels per triangle
+};
+
+enum texture_layout {
+  TEXTURE_LAYOUT_LINEAR, // row-major, as decoded
+  TEXTURE_LAYOUT_TILED,  // 4x4 texel tiles, one cache line each
+  TEXTURE_LAYOUT_BC1,    // 4x4 texel blocks compressed to 8 bytes, opaque only
+};
+
+enum upscale_filter { UPSCALE_NEAREST, UPSCALE_BILINEAR };
+
+enum pacing_mode {
+  PACING_UNCAPPED, // present every frame as soon as it is done
+  PACING_FIXED,    // present at target_frame_time intervals
+  PACING_VSYNC,    // let the display's vertical sync pace presentation
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// How a render context draws its frames, see context.h. Every context has its
+// own copy, so contexts on different threads can use different settings.
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+  enum render_method render_method;
+  enum cull_method cull_method;
+  enum texture_filter texture_filter;
+  enum texture_layout texture_layout; // applied to the textures loaded from then on
+
+  // Rasterize the triangles roughly nearest first, so the depth test rejects most hidden pixels
+  // before they are shaded. Meant for the solid render methods, wireframes are drawn on top of
+  // everything either way.
+  bool front_to_back;
+
+  // Build the geometry of the next frame while the current one is rasterized and presented.
+  bool frame_pipelining;
+
+  // Render resolution as a fraction of the window resolution, and how it is stretched back up.
+  float render_scale;
+  enum upscale_filter upscale_filter;
+
+  // Adjust render_scale every frame to hold target_frame_time.
+  bool dynamic_resolution;
+
+  // Clear the framebuffers tile by tile as the frame draws into them, see clear.h.
+  bool lazy_clear;
+
+  // Rasterize straight into the backend's output (e.g. the locked streaming texture) instead of
+  // copying a separate buffer into it every frame. Falls back to the copy when it cannot be locked,
+  // and while recording a video, which needs to read the frame back.
+  bool zero_copy_present;
+} render_settings_t;
+
+extern const render_settings_t default_render_settings;
+
+// Frame pacing is shared by the whole process, there is only one window to present to. The
+// target frame time is in milliseconds.
+extern float target_frame_time;
+extern enum pacing_mode pacing_mode;
 
 #endif
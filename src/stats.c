@@ -0,0 +1,86 @@
+#include "stats.h"
+#include "clear.h"
+#include "context.h"
+#include "memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Heatmap colors (RGBA32, 0xAABBGGRR) for pixels shaded 0, 1, 2, ... times, the last one for
+// everything above.
+static const color_t overdraw_colors[] = {
+    0xFF000000, // never
+    0xFF7F0000, // once, dark blue
+    0xFFFF7F00, // azure
+    0xFF00C000, // green
+    0xFF00FFFF, // yellow
+    0xFF007FFF, // orange
+    0xFF0000FF, // red
+    0xFFFF00FF, // magenta
+    0xFFFFFFFF, // 8 times or more
+};
+
+#define NUM_OVERDRAW_COLORS (int)(sizeof(overdraw_colors) / sizeof(overdraw_colors[0]))
+
+void reset_render_stats(render_context_t *context) {
+  memset(&context->stats, 0, sizeof(context->stats));
+}
+
+// Start counting overdraw for the frame about to be rasterized at the current render size.
+void begin_overdraw(render_context_t *context) {
+  overdraw_t *overdraw = &context->overdraw;
+  int size = context->window_width * context->window_height;
+  if (size > overdraw->capacity) {
+    memory_free(overdraw->storage);
+    overdraw->storage = (uint8_t *)memory_alloc(MEMORY_FRAMEBUFFER, size);
+    overdraw->capacity = size;
+  }
+  memset(overdraw->storage, 0, (size_t)context->render_width * context->render_height);
+  overdraw->width = context->render_width;
+  overdraw->counts = overdraw->storage;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Stop counting and work out how many shaded pixels were wasted: everything
+// shaded beyond the one write per covered pixel that is left in the frame.
+// The counts stay in place for draw_overdraw_heatmap().
+///////////////////////////////////////////////////////////////////////////////
+void end_overdraw(render_context_t *context) {
+  overdraw_t *overdraw = &context->overdraw;
+  if (overdraw->counts == NULL) {
+    return;
+  }
+  uint64_t covered = 0;
+  int size = context->render_width * context->render_height;
+  for (int i = 0; i < size; i++) {
+    covered += overdraw->counts[i] != 0;
+  }
+  context->stats.pixels_overwritten = context->stats.pixels_shaded - covered;
+  overdraw->counts = NULL;
+}
+
+// Replace the frame with the overdraw counts of the last counted frame.
+void draw_overdraw_heatmap(render_context_t *context) {
+  const overdraw_t *overdraw = &context->overdraw;
+  if (overdraw->storage == NULL) {
+    return;
+  }
+  int render_width = context->render_width;
+  touch_framebuffer(context, 0, 0, render_width - 1, context->render_height - 1);
+  for (int y = 0; y < context->render_height; y++) {
+    const uint8_t *counts = &overdraw->storage[render_width * y];
+    color_t *row = &context->color_buffer[context->color_buffer_stride * y];
+    for (int x = 0; x < render_width; x++) {
+      int count = counts[x] < NUM_OVERDRAW_COLORS ? counts[x] : NUM_OVERDRAW_COLORS - 1;
+      row[x] = overdraw_colors[count];
+    }
+  }
+}
+
+void free_overdraw_buffer(render_context_t *context) {
+  overdraw_t *overdraw = &context->overdraw;
+  memory_free(overdraw->storage);
+  overdraw->storage = NULL;
+  overdraw->capacity = 0;
+  overdraw->counts = NULL;
+}
@@ -0,0 +1,52 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "display.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Work done on a context's current frame, reset by render_frame(). The
+// triangle counts are gathered by the geometry stage in the frame's triangle
+// list and copied here when the frame is rendered.
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+  uint64_t triangles_considered;      // faces the meshes submitted
+  uint64_t triangles_backface_culled; // ...facing away from the camera
+  uint64_t triangles_frustum_culled;  // ...entirely outside one of the frustum planes
+  uint64_t triangles_dropped;         // ...over the triangle list's capacity
+  uint64_t triangles_rasterized;      // triangles handed to the rasterizer
+  uint64_t pixels_tested;             // depth tests
+  uint64_t pixels_shaded;             // pixels that passed the depth test and were written
+  uint64_t pixels_overwritten;        // ...and were later covered again, needs the overdraw counts
+} render_stats_t;
+
+void reset_render_stats(render_context_t *context);
+
+////////////////////////////////////////////////////////////////////////////////
+// Overdraw: while a frame is counted, counts holds, per pixel of the render
+// size, how many times the pixel was shaded (saturating at 255). It is NULL
+// otherwise, so the rasterizer only pays for a test of the pointer.
+// render_frame() counts it for RENDER_OVERDRAW and while profiling.
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+  uint8_t *counts;  // storage while a frame is counted
+  uint8_t *storage; // allocated at the window size, the largest render size there is
+  int capacity;
+  int width; // render width of the counted frame
+} overdraw_t;
+
+static inline void overdraw_pixel(overdraw_t *overdraw, int x, int y) {
+  if (overdraw->counts != NULL) {
+    uint8_t *count = &overdraw->counts[(overdraw->width * y) + x];
+    *count += *count < 255;
+  }
+}
+
+void begin_overdraw(render_context_t *context);
+void end_overdraw(render_context_t *context);
+void draw_overdraw_heatmap(render_context_t *context);
+void free_overdraw_buffer(render_context_t *context);
+
+#endif
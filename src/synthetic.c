@@ -0,0 +1,359 @@
+#include "synthetic.h"
+#include "array.h"
+#include "context.h"
+#include "memory.h"
+#include "mesh.h"
+#include "profiler.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Strict C99's math.h doesn't have it.
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static const char *kind_names[NUM_SYNTHETIC_KINDS] = {
+    [SYNTHETIC_SPHERE] = "sphere",   [SYNTHETIC_TERRAIN] = "terrain",
+    [SYNTHETIC_SOUP] = "soup",       [SYNTHETIC_INSTANCES] = "instances",
+    [SYNTHETIC_SLIVERS] = "slivers",
+};
+
+// Triangles of each small sphere of the instance field.
+#define INSTANCE_STACKS 4
+#define INSTANCE_SLICES 8
+
+// How many times over the soup covers its box, whatever the triangle count.
+#define SOUP_DEPTH_COMPLEXITY 2.0
+
+#define TERRAIN_TILT -0.6 // radians around x, so the camera looks down on it
+
+///////////////////////////////////////////////////////////////////////////////
+// Read a count with an optional k or M suffix, e.g. 250k.
+///////////////////////////////////////////////////////////////////////////////
+static bool parse_count(const char *text, int *count) {
+  char *end;
+  double value = strtod(text, &end);
+  if (*end == 'k' || *end == 'K') {
+    value *= 1e3;
+    end++;
+  } else if (*end == 'm' || *end == 'M') {
+    value *= 1e6;
+    end++;
+  }
+  if (end == text || (*end != '\0' && *end != ':') || value < SYNTHETIC_MIN_TRIANGLES ||
+      value > SYNTHETIC_MAX_TRIANGLES) {
+    return false;
+  }
+  *count = (int)value;
+  return true;
+}
+
+bool synthetic_parse(const char *spec, synthetic_scene_t *scene) {
+  snprintf(scene->name, sizeof(scene->name), "%s", spec);
+  scene->triangles = SYNTHETIC_DEFAULT_TRIANGLES;
+  scene->coverage = SYNTHETIC_DEFAULT_COVERAGE;
+  scene->texture_size = SYNTHETIC_DEFAULT_TEXTURE_SIZE;
+
+  size_t kind_length = strcspn(spec, ":");
+  int kind = 0;
+  while (kind < NUM_SYNTHETIC_KINDS && (strlen(kind_names[kind]) != kind_length ||
+                                        strncmp(spec, kind_names[kind], kind_length) != 0)) {
+    kind++;
+  }
+  if (kind == NUM_SYNTHETIC_KINDS) {
+    fprintf(stderr, "Unknown synthetic scene: %s\n", spec);
+    return false;
+  }
+  scene->kind = (enum synthetic_kind)kind;
+
+  const char *field = spec + kind_length;
+  if (*field == ':' && !parse_count(++field, &scene->triangles)) {
+    fprintf(stderr, "Invalid triangle count in %s, 1 to 10M.\n", spec);
+    return false;
+  }
+  field += strcspn(field, ":");
+  if (*field == ':' && sscanf(++field, "%f", &scene->coverage) != 1) {
+    scene->coverage = 0;
+  }
+  if (scene->coverage <= 0) {
+    fprintf(stderr, "Invalid coverage in %s.\n", spec);
+    return false;
+  }
+  field += strcspn(field, ":");
+  if (*field == ':' && sscanf(++field, "%d", &scene->texture_size) != 1) {
+    scene->texture_size = 0;
+  }
+  if (scene->texture_size <= 0 || scene->texture_size > SYNTHETIC_MAX_TEXTURE_SIZE) {
+    fprintf(stderr, "Invalid texture size in %s.\n", spec);
+    return false;
+  }
+  return true;
+}
+
+// xorshift32, so scenes come out the same whatever the C library's rand() does.
+static uint32_t random_next(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+static float random_range(uint32_t *state, float min, float max) {
+  return min + (max - min) * (random_next(state) >> 8) / 16777216.0f;
+}
+
+static int add_vertex(mesh_t *mesh, float x, float y, float z) {
+  vec3_t vertex = {x, y, z};
+  array_push(mesh->vertices, vertex);
+  return array_length(mesh->vertices) - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Add a face between vertices a, b and c (counting from 0), wound so it is
+// front facing when seen from the side facing points to. A zero facing keeps
+// the order given.
+///////////////////////////////////////////////////////////////////////////////
+static void add_face(mesh_t *mesh, int a, int b, int c, tex2_t a_uv, tex2_t b_uv, tex2_t c_uv,
+                     vec3_t facing) {
+  vec3_t ab = vec3_sub(mesh->vertices[b], mesh->vertices[a]);
+  vec3_t ac = vec3_sub(mesh->vertices[c], mesh->vertices[a]);
+  if (vec3_dot(vec3_cross(ab, ac), facing) < 0) {
+    int index = b;
+    b = c;
+    c = index;
+    tex2_t uv = b_uv;
+    b_uv = c_uv;
+    c_uv = uv;
+  }
+  face_t face = {
+      .a = a + 1,
+      .b = b + 1,
+      .c = c + 1,
+      .a_uv = a_uv,
+      .b_uv = b_uv,
+      .c_uv = c_uv,
+      .color = WHITE,
+  };
+  array_push(mesh->faces, face);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// A UV sphere of stacks rings by slices segments, 2 * slices * (stacks - 1)
+// triangles. The seam and the poles get their own vertices for the UVs.
+///////////////////////////////////////////////////////////////////////////////
+static void add_sphere(mesh_t *mesh, vec3_t center, float radius, int stacks, int slices) {
+  int first = array_length(mesh->vertices);
+  for (int i = 0; i <= stacks; i++) {
+    float phi = M_PI * i / stacks;
+    for (int j = 0; j <= slices; j++) {
+      float theta = 2 * M_PI * j / slices;
+      add_vertex(mesh, center.x + radius * sin(phi) * cos(theta), center.y + radius * cos(phi),
+                 center.z + radius * sin(phi) * sin(theta));
+    }
+  }
+
+  for (int i = 0; i < stacks; i++) {
+    for (int j = 0; j < slices; j++) {
+      int v00 = first + i * (slices + 1) + j;
+      int v01 = v00 + 1;
+      int v10 = v00 + slices + 1;
+      int v11 = v10 + 1;
+      tex2_t uv00 = {(float)j / slices, (float)i / stacks};
+      tex2_t uv01 = {(float)(j + 1) / slices, (float)i / stacks};
+      tex2_t uv10 = {(float)j / slices, (float)(i + 1) / stacks};
+      tex2_t uv11 = {(float)(j + 1) / slices, (float)(i + 1) / stacks};
+      vec3_t outward = vec3_sub(mesh->vertices[v00], center);
+      outward = vec3_add(outward, vec3_sub(mesh->vertices[v11], center));
+
+      // The rows touching the poles would have one degenerate triangle per quad.
+      if (i > 0) {
+        add_face(mesh, v00, v01, v11, uv00, uv01, uv11, outward);
+      }
+      if (i < stacks - 1) {
+        add_face(mesh, v00, v11, v10, uv00, uv11, uv10, outward);
+      }
+    }
+  }
+}
+
+static void generate_sphere(mesh_t *mesh, int triangles, float extent) {
+  // Twice as many slices as stacks keeps the quads about square: 4 * stacks^2 triangles.
+  int stacks = (int)round(sqrt(triangles / 4.0));
+  stacks = stacks < 2 ? 2 : stacks;
+  add_sphere(mesh, (vec3_t){0, 0, 0}, extent, stacks, 2 * stacks);
+}
+
+static float terrain_height(float x, float z) {
+  return 0.15 * (sin(3 * x) * cos(2 * z) + 0.5 * sin(7 * (x + z)) + 0.25 * cos(13 * x - 11 * z));
+}
+
+static void generate_terrain(mesh_t *mesh, int triangles, float extent) {
+  int size = (int)round(sqrt(triangles / 2.0));
+  size = size < 1 ? 1 : size;
+  for (int i = 0; i <= size; i++) {
+    for (int j = 0; j <= size; j++) {
+      float x = 2.0 * j / size - 1;
+      float z = 2.0 * i / size - 1;
+      add_vertex(mesh, x * extent, terrain_height(x, z) * extent, z * extent);
+    }
+  }
+
+  vec3_t up = {0, 1, 0};
+  for (int i = 0; i < size; i++) {
+    for (int j = 0; j < size; j++) {
+      int v00 = i * (size + 1) + j;
+      int v01 = v00 + 1;
+      int v10 = v00 + size + 1;
+      int v11 = v10 + 1;
+      tex2_t uv00 = {(float)j / size, (float)i / size};
+      tex2_t uv01 = {(float)(j + 1) / size, (float)i / size};
+      tex2_t uv10 = {(float)j / size, (float)(i + 1) / size};
+      tex2_t uv11 = {(float)(j + 1) / size, (float)(i + 1) / size};
+      add_face(mesh, v00, v01, v11, uv00, uv01, uv11, up);
+      add_face(mesh, v00, v11, v10, uv00, uv11, uv10, up);
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Triangles facing every way, about half of them culled. They shrink as their
+// count grows so that together they cover the box SOUP_DEPTH_COMPLEXITY times.
+///////////////////////////////////////////////////////////////////////////////
+static void generate_soup(mesh_t *mesh, int triangles, float extent, uint32_t *seed) {
+  float size = 2 * extent * sqrt(4 * SOUP_DEPTH_COMPLEXITY / triangles);
+  vec3_t any = {0, 0, 0};
+  for (int i = 0; i < triangles; i++) {
+    float x = random_range(seed, -extent, extent);
+    float y = random_range(seed, -extent, extent);
+    float z = random_range(seed, -extent, extent);
+    int corners[3];
+    tex2_t uvs[3];
+    for (int j = 0; j < 3; j++) {
+      vec3_t p = {x + random_range(seed, -size, size), y + random_range(seed, -size, size),
+                  z + random_range(seed, -size, size)};
+      corners[j] = add_vertex(mesh, p.x, p.y, p.z);
+      uvs[j] = (tex2_t){0.5 + p.x / (2 * extent), 0.5 + p.y / (2 * extent)};
+    }
+    add_face(mesh, corners[0], corners[1], corners[2], uvs[0], uvs[1], uvs[2], any);
+  }
+}
+
+static void generate_instances(mesh_t *mesh, int triangles, float extent) {
+  int per_instance = 2 * INSTANCE_SLICES * (INSTANCE_STACKS - 1);
+  int count = triangles / per_instance;
+  count = count < 1 ? 1 : count;
+  int side = (int)ceil(cbrt(count));
+  float spacing = 2 * extent / side;
+
+  for (int i = 0; i < count; i++) {
+    vec3_t center = {
+        -extent + spacing * (i % side + 0.5),
+        -extent + spacing * (i / side % side + 0.5),
+        -extent + spacing * (i / (side * side) + 0.5),
+    };
+    add_sphere(mesh, center, spacing * 0.4, INSTANCE_STACKS, INSTANCE_SLICES);
+  }
+}
+
+// A triangle fan around the center, facing the camera.
+static void generate_slivers(mesh_t *mesh, int triangles, float extent) {
+  int center = add_vertex(mesh, 0, 0, 0);
+  for (int i = 0; i < triangles; i++) {
+    float angle = 2 * M_PI * i / triangles;
+    add_vertex(mesh, extent * cos(angle), extent * sin(angle), 0);
+  }
+
+  vec3_t towards_camera = {0, 0, -1};
+  tex2_t center_uv = {0.5, 0.5};
+  for (int i = 0; i < triangles; i++) {
+    int a = center + 1 + i;
+    int b = center + 1 + (i + 1) % triangles;
+    tex2_t a_uv = {0.5 + 0.5 * mesh->vertices[a].x / extent,
+                   0.5 + 0.5 * mesh->vertices[a].y / extent};
+    tex2_t b_uv = {0.5 + 0.5 * mesh->vertices[b].x / extent,
+                   0.5 + 0.5 * mesh->vertices[b].y / extent};
+    add_face(mesh, center, a, b, center_uv, a_uv, b_uv, towards_camera);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// A checkerboard of 8x8 cells over a color gradient, with some per-texel
+// noise so the mip levels differ from each other.
+///////////////////////////////////////////////////////////////////////////////
+static color_t *generate_texels(int size, uint32_t *seed) {
+  color_t *texels = (color_t *)memory_alloc(MEMORY_TEXTURE, sizeof(color_t) * size * size);
+  if (texels == NULL) {
+    return NULL;
+  }
+  int cell = size >= 8 ? size / 8 : 1;
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      int shift = ((x / cell + y / cell) & 1) + 1; // dark and light cells
+      uint32_t noise = random_next(seed) & 31;
+      uint32_t r = (64 + 191 * x / size + noise) >> shift;
+      uint32_t g = (64 + 191 * y / size + noise) >> shift;
+      uint32_t b = (192 + noise) >> shift;
+      texels[y * size + x] = 0xFF000000 | (b << 16) | (g << 8) | r;
+    }
+  }
+  return texels;
+}
+
+bool synthetic_load(render_context_t *context, const synthetic_scene_t *scene, float distance,
+                    float view_height) {
+  uint64_t start = profile_begin();
+  uint32_t seed = 0x9E3779B9;
+  float extent = scene->coverage * view_height / 2;
+
+  mesh_t mesh;
+  memset(&mesh, 0, sizeof(mesh));
+  mesh.scale = (vec3_t){1, 1, 1};
+  mesh.translation = (vec3_t){0, 0, distance};
+
+  switch (scene->kind) {
+  case SYNTHETIC_SPHERE:
+    generate_sphere(&mesh, scene->triangles, extent);
+    break;
+  case SYNTHETIC_TERRAIN:
+    generate_terrain(&mesh, scene->triangles, extent);
+    mesh.rotation.x = TERRAIN_TILT;
+    break;
+  case SYNTHETIC_SOUP:
+    generate_soup(&mesh, scene->triangles, extent, &seed);
+    break;
+  case SYNTHETIC_INSTANCES:
+    generate_instances(&mesh, scene->triangles, extent);
+    break;
+  case SYNTHETIC_SLIVERS:
+    generate_slivers(&mesh, scene->triangles, extent);
+    break;
+  default:
+    break;
+  }
+
+  color_t *texels = generate_texels(scene->texture_size, &seed);
+  if (texels == NULL) {
+    fprintf(stderr, "Out of memory generating %s.\n", scene->name);
+    array_free(mesh.vertices);
+    array_free(mesh.faces);
+    return false;
+  }
+  texture_from_texels(&mesh.texture, scene->texture_size, scene->texture_size, texels,
+                      context->settings.texture_layout);
+  profile_end(PROFILE_LOAD, start);
+
+  fprintf(stderr, "%s: %d triangles, %d vertices\n", scene->name, array_length(mesh.faces),
+          array_length(mesh.vertices));
+  if (!add_mesh(context, &mesh)) {
+    array_free(mesh.vertices);
+    array_free(mesh.faces);
+    free_texture(&mesh.texture);
+    return false;
+  }
+  return true;
+}
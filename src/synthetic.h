@@ -0,0 +1,62 @@
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include "display.h"
+
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Procedurally generated stress scenes, to see how each stage of the renderer
+// scales with the amount of geometry. A scene is described by a string:
+//
+//   KIND[:TRIANGLES[:COVERAGE[:TEXTURE]]]      e.g. sphere:1M:0.5:1024
+//
+// where KIND is one of
+//
+//   sphere      one finely tessellated sphere
+//   terrain     a heightfield grid, tilted towards the camera
+//   soup        randomly placed and oriented triangles in a box
+//   instances   a 3D field of small spheres, baked into one mesh
+//   slivers     a disc cut into one long, thin triangle per slice
+//
+// TRIANGLES takes k and M suffixes (10k, 2M) and is approximate, the shapes
+// are rounded to whole rows and instances. COVERAGE is the fraction of the
+// screen height the scene spans; above 1 it reaches past the edges. TEXTURE is
+// the side of the generated checkerboard. The total area of the triangles
+// doesn't depend on their count, so pixel work stays about the same while the
+// count changes. Every scene is seeded and the same on every run.
+////////////////////////////////////////////////////////////////////////////////
+
+#define SYNTHETIC_DEFAULT_TRIANGLES 100000
+#define SYNTHETIC_DEFAULT_COVERAGE 0.8
+#define SYNTHETIC_DEFAULT_TEXTURE_SIZE 512
+#define SYNTHETIC_MIN_TRIANGLES 1
+#define SYNTHETIC_MAX_TRIANGLES 10000000
+#define SYNTHETIC_MAX_TEXTURE_SIZE 8192
+#define SYNTHETIC_NAME_LENGTH 64
+
+enum synthetic_kind {
+  SYNTHETIC_SPHERE,
+  SYNTHETIC_TERRAIN,
+  SYNTHETIC_SOUP,
+  SYNTHETIC_INSTANCES,
+  SYNTHETIC_SLIVERS,
+  NUM_SYNTHETIC_KINDS
+};
+
+typedef struct {
+  char name[SYNTHETIC_NAME_LENGTH]; // the string it was parsed from
+  enum synthetic_kind kind;
+  int triangles;
+  float coverage;
+  int texture_size;
+} synthetic_scene_t;
+
+bool synthetic_parse(const char *spec, synthetic_scene_t *scene);
+
+// Generate a scene centered distance in front of the camera, where the screen
+// is view_height world units tall, and add it to the context's meshes.
+bool synthetic_load(render_context_t *context, const synthetic_scene_t *scene, float distance,
+                    float view_height);
+
+#endif
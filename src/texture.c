@@ -1,19 +1,524 @@
 #include "texture.h"
+#include "memory.h"
+#include "virtual_texture.h"
 
-int texture_width = 64;
-int texture_height = 64;
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-upng_t *png_texture = NULL;
-color_t *mesh_texture = NULL;
+static bool is_pow2(int n) { return n > 0 && (n & (n - 1)) == 0; }
 
-void load_png_texture_data(char *filename) {
-  png_texture = upng_new_from_file(filename);
-  if (png_texture != NULL) {
-    upng_decode(png_texture);
-    if (upng_get_error(png_texture) == UPNG_EOK) {
-      mesh_texture = (color_t *)upng_get_buffer(png_texture);
-      texture_width = upng_get_width(png_texture);
-      texture_height = upng_get_height(png_texture);
+static void mipmap_init(mipmap_t *mipmap, int width, int height, color_t *texels) {
+  mipmap->width = width;
+  mipmap->height = height;
+  mipmap->tiles_per_row = (width + TEXTURE_TILE_MASK) >> TEXTURE_TILE_SHIFT;
+  mipmap->is_pow2 = is_pow2(width) && is_pow2(height);
+  mipmap->texels = texels;
+  mipmap->blocks = NULL;
+}
+
+// Set up a linear texture whose level 0 is the given texels, which the caller keeps owning.
+void texture_init(texture_t *texture, int width, int height, color_t *texels) {
+  mipmap_init(&texture->levels[0], width, height, texels);
+  texture->layout = TEXTURE_LAYOUT_LINEAR;
+  texture->num_levels = 1;
+  texture->virtual_texture = NULL;
+  texture->png = NULL;
+  texture->owns_texels = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Load a texture file: baked virtual textures (.vtex) are paged in from disk,
+// anything else is decoded as a PNG and converted to the given layout.
+///////////////////////////////////////////////////////////////////////////////
+bool load_texture(texture_t *texture, const char *filename, enum texture_layout layout) {
+  const char *extension = strrchr(filename, '.');
+  if (extension != NULL && strcmp(extension, ".vtex") == 0) {
+    return load_virtual_texture_data(texture, filename);
+  }
+  return load_png_texture_data(texture, filename, layout);
+}
+
+// The decoded image lives in upng's own buffers, so it is charged to the texture memory by hand.
+static void free_png(texture_t *texture) {
+  memory_track(MEMORY_TEXTURE, -(int64_t)upng_get_size(texture->png));
+  upng_free(texture->png);
+  texture->png = NULL;
+}
+
+// Convert a freshly loaded linear texture to the layout the loading context's settings pick.
+static void apply_texture_layout(texture_t *texture, enum texture_layout layout) {
+  if (layout == TEXTURE_LAYOUT_TILED) {
+    texture_tile(texture);
+  } else if (layout == TEXTURE_LAYOUT_BC1) {
+    texture_compress(texture);
+  }
+}
+
+// Decode a PNG opened by upng into the texture, naming it as given in errors.
+static bool decode_png_texture(texture_t *texture, upng_t *png, const char *name,
+                               enum texture_layout layout) {
+  if (png == NULL) {
+    return false;
+  }
+  upng_decode(png);
+  if (upng_get_error(png) != UPNG_EOK) {
+    fprintf(stderr, "Error decoding texture %s.\n", name);
+    upng_free(png);
+    return false;
+  }
+
+  // Level 0 points straight into the decoded PNG buffer, which upng owns.
+  texture_init(texture, upng_get_width(png), upng_get_height(png),
+               (color_t *)upng_get_buffer(png));
+  texture->png = png;
+  memory_track(MEMORY_TEXTURE, upng_get_size(png));
+  generate_mipmaps(texture);
+  apply_texture_layout(texture, layout);
+
+  // Both conversions copy level 0, so the decoded image is no longer needed.
+  if (texture->layout != TEXTURE_LAYOUT_LINEAR) {
+    free_png(texture);
+  }
+  return true;
+}
+
+bool load_png_texture_data(texture_t *texture, const char *filename,
+                           enum texture_layout layout) {
+  return decode_png_texture(texture, upng_new_from_file(filename), filename, layout);
+}
+
+// Same as load_png_texture_data(), from a PNG file already in memory. The data is only read
+// during the call.
+bool load_png_texture_memory(texture_t *texture, const unsigned char *data, size_t size,
+                             enum texture_layout layout) {
+  return decode_png_texture(texture, upng_new_from_bytes(data, (unsigned long)size), "in memory",
+                            layout);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Make a texture out of texels generated in memory, e.g. by synthetic.c. The
+// texels must come from memory_alloc(MEMORY_TEXTURE, ...); the texture takes
+// them over and frees them once they are no longer needed.
+///////////////////////////////////////////////////////////////////////////////
+void texture_from_texels(texture_t *texture, int width, int height, color_t *texels,
+                         enum texture_layout layout) {
+  texture_init(texture, width, height, texels);
+  generate_mipmaps(texture);
+  apply_texture_layout(texture, layout);
+
+  if (texture->layout != TEXTURE_LAYOUT_LINEAR) {
+    memory_free(texels);
+  } else {
+    texture->owns_texels = true;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Open a texture baked with virtual_texture_bake(). Only the level sizes are
+// known up front; the texels are paged in while rendering.
+///////////////////////////////////////////////////////////////////////////////
+bool load_virtual_texture_data(texture_t *texture, const char *filename) {
+  virtual_texture_t *vt = virtual_texture_open(filename, VIRTUAL_TEXTURE_CACHE_SLOTS);
+  if (vt == NULL) {
+    return false;
+  }
+  texture->layout = TEXTURE_LAYOUT_LINEAR;
+  texture->num_levels = vt->num_levels;
+  texture->virtual_texture = vt;
+  texture->png = NULL;
+  texture->owns_texels = false;
+  for (int i = 0; i < vt->num_levels; i++) {
+    mipmap_init(&texture->levels[i], vt->levels[i].width, vt->levels[i].height, NULL);
+  }
+  return true;
+}
+
+// Per-frame bookkeeping, called once the frame has been rasterized.
+void texture_update(texture_t *texture) {
+  if (texture->virtual_texture != NULL) {
+    virtual_texture_update(texture->virtual_texture);
+  }
+}
+
+void free_texture(texture_t *texture) {
+  if (texture->virtual_texture != NULL) {
+    virtual_texture_close(texture->virtual_texture);
+    texture->virtual_texture = NULL;
+    texture->num_levels = 0;
+    return;
+  }
+
+  for (int i = 0; i < texture->num_levels; i++) {
+    // A linear level 0 belongs to the image decoder unless it was handed over, the rest is ours.
+    if (i > 0 || texture->layout != TEXTURE_LAYOUT_LINEAR || texture->owns_texels) {
+      memory_free(texture->levels[i].texels);
+    }
+    memory_free(texture->levels[i].blocks);
+  }
+  texture->num_levels = 0;
+
+  if (texture->png != NULL) {
+    free_png(texture);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Average four texels channel by channel. Every channel gets its own 16-bit
+// lane in the masked words, so the sums of four 8-bit values never overflow
+// into the neighbouring channel.
+///////////////////////////////////////////////////////////////////////////////
+static color_t color_average4(color_t a, color_t b, color_t c, color_t d) {
+  uint32_t rb = (a & 0x00FF00FF) + (b & 0x00FF00FF) + (c & 0x00FF00FF) + (d & 0x00FF00FF);
+  uint32_t ag = ((a >> 8) & 0x00FF00FF) + ((b >> 8) & 0x00FF00FF) + ((c >> 8) & 0x00FF00FF) +
+                ((d >> 8) & 0x00FF00FF);
+  rb = ((rb + 0x00020002) >> 2) & 0x00FF00FF;
+  ag = ((ag + 0x00020002) >> 2) & 0x00FF00FF;
+  return rb | (ag << 8);
+}
+
+// Linear blend between two colors where t goes from 0 (all a) to 256 (all b).
+static color_t color_lerp(color_t a, color_t b, uint32_t t) {
+  uint32_t rb = ((a & 0x00FF00FF) * (256 - t) + (b & 0x00FF00FF) * t) >> 8;
+  uint32_t ag = (((a >> 8) & 0x00FF00FF) * (256 - t) + ((b >> 8) & 0x00FF00FF) * t) >> 8;
+  return (rb & 0x00FF00FF) | ((ag & 0x00FF00FF) << 8);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Build the rest of the mip chain from level 0 with a 2x2 box filter.
+// Odd sized levels reuse their last row/column for the missing neighbour.
+// This works on linear levels, so it has to run before texture_tile().
+///////////////////////////////////////////////////////////////////////////////
+void generate_mipmaps(texture_t *texture) {
+  while (texture->num_levels < MAX_MIPMAP_LEVELS) {
+    mipmap_t *src = &texture->levels[texture->num_levels - 1];
+    if (src->width == 1 && src->height == 1) {
+      break;
+    }
+
+    int width = src->width > 1 ? src->width / 2 : 1;
+    int height = src->height > 1 ? src->height / 2 : 1;
+    color_t *texels = (color_t *)memory_alloc(MEMORY_TEXTURE, sizeof(color_t) * width * height);
+
+    for (int y = 0; y < height; y++) {
+      int y0 = y * 2;
+      int y1 = y0 + 1 < src->height ? y0 + 1 : y0;
+      color_t *row0 = &src->texels[src->width * y0];
+      color_t *row1 = &src->texels[src->width * y1];
+
+      for (int x = 0; x < width; x++) {
+        int x0 = x * 2;
+        int x1 = x0 + 1 < src->width ? x0 + 1 : x0;
+        texels[(width * y) + x] = color_average4(row0[x0], row0[x1], row1[x0], row1[x1]);
+      }
+    }
+
+    mipmap_init(&texture->levels[texture->num_levels], width, height, texels);
+    texture->num_levels += 1;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Index of texel (x, y) in the tiled layout. Tiles are stored row by row and
+// the texels inside a tile are row-major too:
+//
+//   +----+----+----+
+//   | t0 | t1 | t2 |   each tile:  0  1  2  3
+//   +----+----+----+               4  5  6  7
+//   | t3 | t4 | t5 |               8  9 10 11
+//   +----+----+----+              12 13 14 15
+//
+///////////////////////////////////////////////////////////////////////////////
+static int tiled_index(mipmap_t *mipmap, int x, int y) {
+  int tile = (y >> TEXTURE_TILE_SHIFT) * mipmap->tiles_per_row + (x >> TEXTURE_TILE_SHIFT);
+  int texel = ((y & TEXTURE_TILE_MASK) << TEXTURE_TILE_SHIFT) | (x & TEXTURE_TILE_MASK);
+  return (tile << (2 * TEXTURE_TILE_SHIFT)) | texel;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert every level of a linear texture to the tiled layout, so a triangle
+// walking the texture vertically stays inside the same cache line for four
+// texels instead of touching a new one on every pixel. Levels are padded up to
+// whole tiles and aligned to the cache line size.
+///////////////////////////////////////////////////////////////////////////////
+void texture_tile(texture_t *texture) {
+  if (texture->layout == TEXTURE_LAYOUT_TILED) {
+    return;
+  }
+
+  // Allocate every level before converting any, so running out of memory leaves the texture
+  // linear and whole.
+  color_t *tiled[MAX_MIPMAP_LEVELS];
+  for (int i = 0; i < texture->num_levels; i++) {
+    mipmap_t *mipmap = &texture->levels[i];
+    int tile_rows = (mipmap->height + TEXTURE_TILE_MASK) >> TEXTURE_TILE_SHIFT;
+    size_t size = sizeof(color_t) * mipmap->tiles_per_row * tile_rows * TEXTURE_TILE_SIZE *
+                  TEXTURE_TILE_SIZE;
+
+    tiled[i] = (color_t *)memory_alloc_aligned(MEMORY_TEXTURE, size, 64);
+    if (tiled[i] == NULL) {
+      while (i-- > 0) {
+        memory_free(tiled[i]);
+      }
+      return;
     }
+    memset(tiled[i], 0, size);
+  }
+
+  for (int i = 0; i < texture->num_levels; i++) {
+    mipmap_t *mipmap = &texture->levels[i];
+    for (int y = 0; y < mipmap->height; y++) {
+      for (int x = 0; x < mipmap->width; x++) {
+        tiled[i][tiled_index(mipmap, x, y)] = mipmap->texels[(mipmap->width * y) + x];
+      }
+    }
+
+    // Level 0 still belongs to the image decoder.
+    if (i > 0) {
+      memory_free(mipmap->texels);
+    }
+    mipmap->texels = tiled[i];
+  }
+  texture->layout = TEXTURE_LAYOUT_TILED;
+}
+
+static uint16_t color_to_565(color_t c) {
+  return ((c & 0xF8) << 8) | ((c >> 5) & 0x07E0) | ((c >> 19) & 0x1F);
+}
+
+static color_t color_from_565(uint16_t c) {
+  uint32_t r = (c >> 11) & 0x1F;
+  uint32_t g = (c >> 5) & 0x3F;
+  uint32_t b = c & 0x1F;
+  r = (r << 3) | (r >> 2);
+  g = (g << 2) | (g >> 4);
+  b = (b << 3) | (b >> 2);
+  return 0xFF000000 | (b << 16) | (g << 8) | r;
+}
+
+static int color_distance(color_t a, color_t b) {
+  int dr = (int)(a & 0xFF) - (int)(b & 0xFF);
+  int dg = (int)((a >> 8) & 0xFF) - (int)((b >> 8) & 0xFF);
+  int db = (int)((a >> 16) & 0xFF) - (int)((b >> 16) & 0xFF);
+  return dr * dr + dg * dg + db * db;
+}
+
+// Opaque mix of w0/3 of color a and (3 - w0)/3 of color b.
+static color_t color_mix_thirds(color_t a, color_t b, uint32_t w0) {
+  uint32_t w1 = 3 - w0;
+  uint32_t r = ((a & 0xFF) * w0 + (b & 0xFF) * w1) / 3;
+  uint32_t g = (((a >> 8) & 0xFF) * w0 + ((b >> 8) & 0xFF) * w1) / 3;
+  uint32_t bl = (((a >> 16) & 0xFF) * w0 + ((b >> 16) & 0xFF) * w1) / 3;
+  return 0xFF000000 | (bl << 16) | (g << 8) | r;
+}
+
+// The four colors a block can pick from: both endpoints and the two in between.
+static void bc1_palette(uint16_t color0, uint16_t color1, color_t palette[4]) {
+  palette[0] = color_from_565(color0);
+  palette[1] = color_from_565(color1);
+  palette[2] = color_mix_thirds(palette[0], palette[1], 2);
+  palette[3] = color_mix_thirds(palette[0], palette[1], 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Compress a 4x4 block. The endpoints are the corners of the block's color
+// bounding box, pulled in by 1/16 of its size so outliers don't waste range,
+// and every texel then picks the closest of the four palette colors.
+///////////////////////////////////////////////////////////////////////////////
+static bc1_block_t bc1_encode(color_t texels[16]) {
+  int min[3] = {255, 255, 255};
+  int max[3] = {0, 0, 0};
+  for (int i = 0; i < 16; i++) {
+    for (int c = 0; c < 3; c++) {
+      int value = (texels[i] >> (8 * c)) & 0xFF;
+      min[c] = value < min[c] ? value : min[c];
+      max[c] = value > max[c] ? value : max[c];
+    }
+  }
+
+  color_t low = 0;
+  color_t high = 0;
+  for (int c = 0; c < 3; c++) {
+    int inset = (max[c] - min[c]) >> 4;
+    low |= (color_t)(min[c] + inset) << (8 * c);
+    high |= (color_t)(max[c] - inset) << (8 * c);
+  }
+
+  bc1_block_t block = {.color0 = color_to_565(high), .color1 = color_to_565(low), .indices = 0};
+  // BC1 only interpolates when color0 > color1; a flat block just uses color0 everywhere.
+  if (block.color0 <= block.color1) {
+    block.color1 = block.color0;
+    return block;
+  }
+
+  color_t palette[4];
+  bc1_palette(block.color0, block.color1, palette);
+  for (int i = 0; i < 16; i++) {
+    int best = 0;
+    int best_distance = color_distance(texels[i], palette[0]);
+    for (int p = 1; p < 4; p++) {
+      int distance = color_distance(texels[i], palette[p]);
+      if (distance < best_distance) {
+        best = p;
+        best_distance = distance;
+      }
+    }
+    block.indices |= (uint32_t)best << (2 * i);
+  }
+  return block;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Compress every level of a linear texture into BC1 blocks, laid out like the
+// tiles of texture_tile(). This cuts texture memory and bandwidth by 8x at the
+// price of decoding in the sampler. Alpha is dropped, every texel is opaque.
+///////////////////////////////////////////////////////////////////////////////
+void texture_compress(texture_t *texture) {
+  if (texture->layout != TEXTURE_LAYOUT_LINEAR) {
+    return;
+  }
+
+  // Allocate every level before encoding any, so running out of memory leaves the texture
+  // linear and whole.
+  bc1_block_t *blocks[MAX_MIPMAP_LEVELS];
+  for (int i = 0; i < texture->num_levels; i++) {
+    mipmap_t *mipmap = &texture->levels[i];
+    int block_rows = (mipmap->height + TEXTURE_TILE_MASK) >> TEXTURE_TILE_SHIFT;
+    blocks[i] = (bc1_block_t *)memory_alloc(
+        MEMORY_TEXTURE, sizeof(bc1_block_t) * mipmap->tiles_per_row * block_rows);
+    if (blocks[i] == NULL) {
+      while (i-- > 0) {
+        memory_free(blocks[i]);
+      }
+      return;
+    }
+  }
+
+  for (int i = 0; i < texture->num_levels; i++) {
+    mipmap_t *mipmap = &texture->levels[i];
+    int block_rows = (mipmap->height + TEXTURE_TILE_MASK) >> TEXTURE_TILE_SHIFT;
+    mipmap->blocks = blocks[i];
+
+    for (int by = 0; by < block_rows; by++) {
+      for (int bx = 0; bx < mipmap->tiles_per_row; bx++) {
+        // Gather the block, clamping to the last row/column on the edges.
+        color_t texels[16];
+        for (int y = 0; y < TEXTURE_TILE_SIZE; y++) {
+          int src_y = (by << TEXTURE_TILE_SHIFT) + y;
+          src_y = src_y < mipmap->height ? src_y : mipmap->height - 1;
+          for (int x = 0; x < TEXTURE_TILE_SIZE; x++) {
+            int src_x = (bx << TEXTURE_TILE_SHIFT) + x;
+            src_x = src_x < mipmap->width ? src_x : mipmap->width - 1;
+            texels[(y << TEXTURE_TILE_SHIFT) | x] = mipmap->texels[(mipmap->width * src_y) + src_x];
+          }
+        }
+        mipmap->blocks[(by * mipmap->tiles_per_row) + bx] = bc1_encode(texels);
+      }
+    }
+
+    // Level 0 still belongs to the image decoder.
+    if (i > 0) {
+      memory_free(mipmap->texels);
+    }
+    mipmap->texels = NULL;
+  }
+  texture->layout = TEXTURE_LAYOUT_BC1;
+}
+
+// Decode the single texel (x, y) out of its compressed block.
+static color_t bc1_fetch(mipmap_t *mipmap, int x, int y) {
+  int block_index = (y >> TEXTURE_TILE_SHIFT) * mipmap->tiles_per_row + (x >> TEXTURE_TILE_SHIFT);
+  bc1_block_t *block = &mipmap->blocks[block_index];
+  int index = (block->indices >> (2 * (((y & TEXTURE_TILE_MASK) << TEXTURE_TILE_SHIFT) |
+                                       (x & TEXTURE_TILE_MASK)))) &
+              3;
+
+  color_t c0 = color_from_565(block->color0);
+  if (index == 0) {
+    return c0;
+  }
+  color_t c1 = color_from_565(block->color1);
+  if (index == 1) {
+    return c1;
+  }
+
+  // Indices 2 and 3 sit at 1/3 and 2/3 of the way from color0 to color1.
+  return color_mix_thirds(c0, c1, index == 2 ? 2 : 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Pick the level of detail for a whole triangle from the ratio between the
+// area it covers in the texture (in texels) and on the screen (in pixels).
+// Each mip level divides the texel area by 4, hence the half of the log2.
+///////////////////////////////////////////////////////////////////////////////
+float texture_lod(texture_t *texture, enum texture_filter filter, float screen_area,
+                  float uv_area) {
+  if (filter == FILTER_NEAREST || texture->num_levels <= 1 || screen_area <= 0) {
+    return 0;
+  }
+
+  float texel_area = uv_area * texture->levels[0].width * texture->levels[0].height;
+  float lod = 0.5 * log2f(texel_area / screen_area);
+
+  float max_lod = texture->num_levels - 1;
+  if (!(lod > 0)) {
+    lod = 0;
+  }
+  if (lod > max_lod) {
+    lod = max_lod;
+  }
+
+  // Without trilinear filtering we just snap to the closest level.
+  if (filter == FILTER_MIPMAP) {
+    lod = floorf(lod + 0.5);
+  }
+  return lod;
+}
+
+static color_t mipmap_sample(mipmap_t *mipmap, enum texture_layout layout, float u, float v) {
+  // Map the UV coordinate to the full texture width and height
+  // These wraps at the end are hacks.
+  int tex_x = abs((int)(u * mipmap->width));
+  int tex_y = abs((int)(v * mipmap->height));
+
+  // Power of two textures wrap with a mask instead of an integer division.
+  if (mipmap->is_pow2) {
+    tex_x &= mipmap->width - 1;
+    tex_y &= mipmap->height - 1;
+  } else {
+    tex_x %= mipmap->width;
+    tex_y %= mipmap->height;
+  }
+
+  if (layout == TEXTURE_LAYOUT_TILED) {
+    return mipmap->texels[tiled_index(mipmap, tex_x, tex_y)];
+  }
+  if (layout == TEXTURE_LAYOUT_BC1) {
+    return bc1_fetch(mipmap, tex_x, tex_y);
+  }
+  return mipmap->texels[(mipmap->width * tex_y) + tex_x];
+}
+
+static color_t level_sample(texture_t *texture, int level, float u, float v) {
+  if (texture->virtual_texture != NULL) {
+    return virtual_texture_sample(texture->virtual_texture, level, u, v);
+  }
+  return mipmap_sample(&texture->levels[level], texture->layout, u, v);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Fetch the texel at (u, v) for the given level of detail. A fractional LOD
+// blends the two closest levels (trilinear filtering).
+///////////////////////////////////////////////////////////////////////////////
+color_t texture_sample(texture_t *texture, float lod, float u, float v) {
+  int level = (int)lod;
+  color_t color = level_sample(texture, level, u, v);
+
+  float fraction = lod - level;
+  if (fraction > 0 && level + 1 < texture->num_levels) {
+    color_t next = level_sample(texture, level + 1, u, v);
+    color = color_lerp(color, next, (uint32_t)(fraction * 256));
   }
+  return color;
 }
@@ -2,18 +2,74 @@
 #define TEXTURE_H
 
 #include "colors.h"
+#include "settings.h"
 #include "upng.h"
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Enough levels for a 32K x 32K texture down to 1x1.
+#define MAX_MIPMAP_LEVELS 16
+
+// Tiled textures are stored in 4x4 blocks of texels, which is exactly one 64 byte cache line.
+#define TEXTURE_TILE_SIZE 4
+#define TEXTURE_TILE_SHIFT 2
+#define TEXTURE_TILE_MASK (TEXTURE_TILE_SIZE - 1)
+
 typedef struct {
   float u, v;
 } tex2_t;
 
-extern int texture_width;
-extern int texture_height;
+////////////////////////////////////////////////////////////////////////////////
+// A BC1 style compressed block of 4x4 texels: two RGB565 endpoint colors and a
+// 2-bit index per texel choosing between the endpoints and the two colors at
+// 1/3 and 2/3 of the way between them. 8 bytes instead of 64.
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+  uint16_t color0;
+  uint16_t color1;
+  uint32_t indices;
+} bc1_block_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// A single level of a mip chain. Level 0 is the full resolution image and each
+// following level halves the width and height (never going below 1).
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+  int width;
+  int height;
+  int tiles_per_row; // used by the tiled and BC1 layouts
+  bool is_pow2;      // both sides are powers of two, so wrapping can use masks
+  color_t *texels;
+  bc1_block_t *blocks; // only used by the BC1 layout
+} mipmap_t;
+
+typedef struct {
+  enum texture_layout layout;
+  int num_levels;
+  mipmap_t levels[MAX_MIPMAP_LEVELS];
+  struct virtual_texture *virtual_texture; // texels are paged in from disk when set
+  upng_t *png;      // decoded image a linear level 0 points into, if it came from a PNG
+  bool owns_texels; // a linear level 0 was handed over by texture_from_texels()
+} texture_t;
 
-extern upng_t *png_texture;
-extern color_t *mesh_texture;
+bool load_texture(texture_t *texture, const char *filename, enum texture_layout layout);
+bool load_png_texture_data(texture_t *texture, const char *filename, enum texture_layout layout);
+bool load_png_texture_memory(texture_t *texture, const unsigned char *data, size_t size,
+                             enum texture_layout layout);
+bool load_virtual_texture_data(texture_t *texture, const char *filename);
+void texture_init(texture_t *texture, int width, int height, color_t *texels);
+void texture_from_texels(texture_t *texture, int width, int height, color_t *texels,
+                         enum texture_layout layout);
+void texture_update(texture_t *texture);
+void free_texture(texture_t *texture);
 
-void load_png_texture_data(char *filename);
+void generate_mipmaps(texture_t *texture);
+void texture_tile(texture_t *texture);
+void texture_compress(texture_t *texture);
+float texture_lod(texture_t *texture, enum texture_filter filter, float screen_area,
+                  float uv_area);
+color_t texture_sample(texture_t *texture, float lod, float u, float v);
 
 #endif
@@ -0,0 +1,137 @@
+#include "trace.h"
+#include "clock.h"
+#include "memory.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+bool tracing = false;
+
+static FILE *file = NULL;
+static uint64_t trace_start = 0;
+static bool first_record = true;
+
+static trace_record_t *queue = NULL;
+static int head = 0;
+static int count = 0;
+static int dropped = 0;
+static bool closing = false;
+
+static pthread_t writer_thread;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+static void write_record(const trace_record_t *record) {
+  // Timestamps are in microseconds.
+  double ts = record->start >= trace_start ? (record->start - trace_start) / 1e3 : 0;
+
+  fprintf(file, "%s\n{\"ph\":\"%c\",\"pid\":1,\"tid\":%d,", first_record ? "" : ",",
+          record->phase, record->thread);
+  first_record = false;
+
+  switch (record->phase) {
+  case 'X':
+    fprintf(file, "\"name\":\"%s\",\"ts\":%.3f,\"dur\":%.3f", record->name, ts,
+            record->value / 1e3);
+    if (record->frame >= 0) {
+      fprintf(file, ",\"args\":{\"frame\":%d}", record->frame);
+    }
+    break;
+  case 'C':
+    fprintf(file, "\"name\":\"%s\",\"ts\":%.3f,\"args\":{\"value\":%llu}", record->name, ts,
+            (unsigned long long)record->value);
+    break;
+  case 'M':
+    fprintf(file, "\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}", record->name);
+    break;
+  }
+  fprintf(file, "}");
+}
+
+static void *writer(void *arg) {
+  (void)arg;
+  trace_record_t batch[256];
+
+  pthread_mutex_lock(&mutex);
+  while (true) {
+    while (count == 0 && !closing) {
+      pthread_cond_wait(&cond, &mutex);
+    }
+    if (count == 0) {
+      break;
+    }
+    // Copy a batch out, so the renderer can keep queueing while it is written.
+    int n = 0;
+    while (count > 0 && n < 256) {
+      batch[n++] = queue[(head - count + TRACE_QUEUE_SIZE) % TRACE_QUEUE_SIZE];
+      count--;
+    }
+    pthread_mutex_unlock(&mutex);
+
+    for (int i = 0; i < n; i++) {
+      write_record(&batch[i]);
+    }
+
+    pthread_mutex_lock(&mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+  return NULL;
+}
+
+bool trace_open(const char *filename) {
+  file = fopen(filename, "w");
+  if (file == NULL) {
+    fprintf(stderr, "Error opening trace %s.\n", filename);
+    return false;
+  }
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+  queue =
+      (trace_record_t *)memory_alloc(MEMORY_FRAME, sizeof(trace_record_t) * TRACE_QUEUE_SIZE);
+  head = count = dropped = 0;
+  closing = false;
+  first_record = true;
+  trace_start = clock_ns();
+  tracing = true;
+  pthread_create(&writer_thread, NULL, writer, NULL);
+  return true;
+}
+
+// Queue records for the writer. Never waits for it: records that don't fit are dropped.
+void trace_push(const trace_record_t *records, int num_records) {
+  pthread_mutex_lock(&mutex);
+  for (int i = 0; i < num_records; i++) {
+    if (count == TRACE_QUEUE_SIZE) {
+      dropped += num_records - i;
+      break;
+    }
+    queue[head] = records[i];
+    head = (head + 1) % TRACE_QUEUE_SIZE;
+    count++;
+  }
+  pthread_cond_signal(&cond);
+  pthread_mutex_unlock(&mutex);
+}
+
+void trace_close(void) {
+  if (file == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&mutex);
+  closing = true;
+  pthread_cond_signal(&cond);
+  pthread_mutex_unlock(&mutex);
+  pthread_join(writer_thread, NULL);
+
+  fprintf(file, "\n]}\n");
+  fclose(file);
+  file = NULL;
+  memory_free(queue);
+  queue = NULL;
+  tracing = false;
+
+  if (dropped > 0) {
+    fprintf(stderr, "Trace queue overflowed, %d events dropped.\n", dropped);
+  }
+}
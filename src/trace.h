@@ -0,0 +1,32 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Chrome Trace Event Format output, for chrome://tracing or Perfetto. The
+// profiler hands its events over once per frame; a background thread formats
+// and writes them. The queue between the two has a fixed size and events
+// that don't fit are dropped (and counted), so a slow disk costs trace
+// detail, never frame time or memory.
+////////////////////////////////////////////////////////////////////////////////
+
+#define TRACE_QUEUE_SIZE 65536
+
+typedef struct {
+  char phase;       // 'X' complete event, 'C' counter, 'M' thread name metadata
+  int thread;       // trace thread id
+  const char *name; // must outlive the trace, the writer reads it later
+  uint64_t start;   // clock_ns() timestamp
+  uint64_t value;   // duration in nanoseconds for 'X', the value for 'C'
+  int frame;        // frame number argument, -1 for none
+} trace_record_t;
+
+extern bool tracing;
+
+bool trace_open(const char *filename);
+void trace_push(const trace_record_t *records, int count);
+void trace_close(void);
+
+#endif
@@ -1,7 +1,28 @@
 #include "triangle.h"
+#include "clear.h"
+#include "context.h"
 #include "display.h"
+#include "stats.h"
 #include "swap.h"
 
+#include <math.h>
+#include <stdlib.h>
+
+static int min3(int a, int b, int c) { return a < b ? (a < c ? a : c) : (b < c ? b : c); }
+static int max3(int a, int b, int c) { return a > b ? (a > c ? a : c) : (b > c ? b : c); }
+
+// Triangles are not clipped against the screen edges, so the rows and spans they fill are.
+static int first_row(int y) { return y > 0 ? y : 0; }
+
+static int last_row(const render_context_t *context, int y) {
+  return y < context->render_height - 1 ? y : context->render_height - 1;
+}
+
+static void clip_span(const render_context_t *context, int *x_start, int *x_end) {
+  *x_start = *x_start > 0 ? *x_start : 0;
+  *x_end = *x_end < context->render_width ? *x_end : context->render_width;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Return the barycentric weights alpha, beta, and gamma for point p
 ///////////////////////////////////////////////////////////////////////////////
@@ -40,8 +61,8 @@ vec3_t barycentric_weights(vec2_t a, vec2_t b, vec2_t c, vec2_t p) {
   return weights;
 }
 
-void draw_triangle_pixel(int x, int y, color_t color, vec4_t point_a, vec4_t point_b,
-                         vec4_t point_c) {
+void draw_triangle_pixel(render_context_t *context, int x, int y, color_t color, vec4_t point_a,
+                         vec4_t point_b, vec4_t point_c) {
   vec2_t p = {x, y};
   vec2_t a = vec2_from_vec4(point_a);
   vec2_t b = vec2_from_vec4(point_b);
@@ -61,12 +82,16 @@ void draw_triangle_pixel(int x, int y, color_t color, vec4_t point_a, vec4_t poi
   interpolated_reciprocal_w = 1.0 - interpolated_reciprocal_w;
 
   // Only draw the pixel if the depth value is less than the one previously stored in the z-buffer.
-  if (interpolated_reciprocal_w < z_buffer[(window_width * y) + x]) {
+  float *depth = &context->z_buffer[(context->render_width * y) + x];
+  context->stats.pixels_tested++;
+  if (interpolated_reciprocal_w < *depth) {
     // Draw a pixel at position (x, y) with the color that come from the mapped texture.
-    draw_pixel(x, y, color);
+    draw_pixel(context, x, y, color);
 
     // Update the z-buffer value with the 1 / w of this current pixel.
-    z_buffer[(window_width * y) + x] = interpolated_reciprocal_w;
+    *depth = interpolated_reciprocal_w;
+    context->stats.pixels_shaded++;
+    overdraw_pixel(&context->overdraw, x, y);
   }
 }
 
@@ -90,8 +115,9 @@ void draw_triangle_pixel(int x, int y, color_t color, vec4_t point_a, vec4_t poi
 //                       (x2,y2)
 //
 ///////////////////////////////////////////////////////////////////////////////
-void draw_filled_triangle(int x0, int y0, float z0, float w0, int x1, int y1, float z1, float w1,
-                          int x2, int y2, float z2, float w2, color_t color) {
+void draw_filled_triangle(render_context_t *context, int x0, int y0, float z0, float w0, int x1,
+                          int y1, float z1, float w1, int x2, int y2, float z2, float w2,
+                          color_t color) {
   // We need to sort the vertices by y-coordinate ascending (y0 < y1 < y2)
   if (y0 > y1) {
     int_swap(&y0, &y1);
@@ -116,6 +142,8 @@ void draw_filled_triangle(int x0, int y0, float z0, float w0, int x1, int y1, fl
   vec4_t point_b = {x1, y1, z1, w1};
   vec4_t point_c = {x2, y2, z2, w2};
 
+  touch_framebuffer(context, min3(x0, x1, x2), y0, max3(x0, x1, x2), y2);
+
   ///////////////////////////////////////////////////////
   // Render the upper part of the triangle (flat-bottom)
   ///////////////////////////////////////////////////////
@@ -128,16 +156,17 @@ void draw_filled_triangle(int x0, int y0, float z0, float w0, int x1, int y1, fl
     inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
 
   if (y1 - y0 != 0) {
-    for (int y = y0; y <= y1; y++) {
+    for (int y = first_row(y0); y <= last_row(context, y1); y++) {
       int x_start = x1 + (y - y1) * inv_slope_1;
       int x_end = x0 + (y - y0) * inv_slope_2;
 
       if (x_end < x_start)
         int_swap(&x_start, &x_end); // swap if x_start is to the right of x_end
+      clip_span(context, &x_start, &x_end);
 
       for (int x = x_start; x < x_end; x++) {
         // Draw our pixel with the color that comes from the texture
-        draw_triangle_pixel(x, y, color, point_a, point_b, point_c);
+        draw_triangle_pixel(context, x, y, color, point_a, point_b, point_c);
       }
     }
   }
@@ -154,16 +183,17 @@ void draw_filled_triangle(int x0, int y0, float z0, float w0, int x1, int y1, fl
     inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
 
   if (y2 - y1 != 0) {
-    for (int y = y1; y <= y2; y++) {
+    for (int y = first_row(y1); y <= last_row(context, y2); y++) {
       int x_start = x1 + (y - y1) * inv_slope_1;
       int x_end = x0 + (y - y0) * inv_slope_2;
 
       if (x_end < x_start)
         int_swap(&x_start, &x_end); // swap if x_start is to the right of x_end
+      clip_span(context, &x_start, &x_end);
 
       for (int x = x_start; x < x_end; x++) {
         // Draw our pixel with the color that comes from the texture
-        draw_triangle_pixel(x, y, color, point_a, point_b, point_c);
+        draw_triangle_pixel(context, x, y, color, point_a, point_b, point_c);
       }
     }
   }
@@ -172,17 +202,19 @@ void draw_filled_triangle(int x0, int y0, float z0, float w0, int x1, int y1, fl
 ///////////////////////////////////////////////////////////////////////////////
 // Draw a triangle using three raw line calls
 ///////////////////////////////////////////////////////////////////////////////
-void draw_triangle(int x0, int y0, int x1, int y1, int x2, int y2, color_t color) {
-  draw_line(x0, y0, x1, y1, color);
-  draw_line(x1, y1, x2, y2, color);
-  draw_line(x2, y2, x0, y0, color);
+void draw_triangle(render_context_t *context, int x0, int y0, int x1, int y1, int x2, int y2,
+                   color_t color) {
+  draw_line(context, x0, y0, x1, y1, color);
+  draw_line(context, x1, y1, x2, y2, color);
+  draw_line(context, x2, y2, x0, y0, color);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // Function to draw the textured pixel at position x and y using interpolation
 ///////////////////////////////////////////////////////////////////////////////
-void draw_texel(int x, int y, color_t *texture, vec4_t point_a, vec4_t point_b, vec4_t point_c,
-                tex2_t a_uv, tex2_t b_uv, tex2_t c_uv) {
+void draw_texel(render_context_t *context, int x, int y, texture_t *texture, float lod,
+                vec4_t point_a, vec4_t point_b, vec4_t point_c, tex2_t a_uv, tex2_t b_uv,
+                tex2_t c_uv) {
   vec2_t p = {x, y};
   vec2_t a = vec2_from_vec4(point_a);
   vec2_t b = vec2_from_vec4(point_b);
@@ -214,21 +246,20 @@ void draw_texel(int x, int y, color_t *texture, vec4_t point_a, vec4_t point_b,
   interpolated_u /= interpolated_reciprocal_w;
   interpolated_v /= interpolated_reciprocal_w;
 
-  // Map the UV coordinate to the full texture width and height
-  // These mods at the end are hacks.
-  int tex_x = abs((int)(interpolated_u * texture_width)) % texture_width;
-  int tex_y = abs((int)(interpolated_v * texture_height)) % texture_height;
-
   // Adjust the 1 / w so the pixels that are closer to the camera have smaller values.
   interpolated_reciprocal_w = 1.0 - interpolated_reciprocal_w;
 
   // Only draw the pixel if the depth value is less than the one previously stored in the z-buffer.
-  if (interpolated_reciprocal_w < z_buffer[(window_width * y) + x]) {
+  float *depth = &context->z_buffer[(context->render_width * y) + x];
+  context->stats.pixels_tested++;
+  if (interpolated_reciprocal_w < *depth) {
     // Draw a pixel at position (x, y) with the color that come from the mapped texture.
-    draw_pixel(x, y, texture[(texture_width * tex_y) + tex_x]);
+    draw_pixel(context, x, y, texture_sample(texture, lod, interpolated_u, interpolated_v));
 
     // Update the z-buffer value with the 1 / w of this current pixel.
-    z_buffer[(window_width * y) + x] = interpolated_reciprocal_w;
+    *depth = interpolated_reciprocal_w;
+    context->stats.pixels_shaded++;
+    overdraw_pixel(&context->overdraw, x, y);
   }
 }
 
@@ -252,9 +283,10 @@ void draw_texel(int x, int y, color_t *texture, vec4_t point_a, vec4_t point_b,
 //                    v2
 //
 ///////////////////////////////////////////////////////////////////////////////
-void draw_textured_triangle(int x0, int y0, float z0, float w0, float u0, float v0, int x1, int y1,
-                            float z1, float w1, float u1, float v1, int x2, int y2, float z2,
-                            float w2, float u2, float v2, color_t *texture) {
+void draw_textured_triangle(render_context_t *context, int x0, int y0, float z0, float w0,
+                            float u0, float v0, int x1, int y1, float z1, float w1, float u1,
+                            float v1, int x2, int y2, float z2, float w2, float u2, float v2,
+                            texture_t *texture) {
   // We need to sort the vertices by y-coordinate ascending (y0 < y1 < y2)
   if (y0 > y1) {
     int_swap(&y0, &y1);
@@ -294,6 +326,14 @@ void draw_textured_triangle(int x0, int y0, float z0, float w0, float u0, float
   tex2_t b_uv = {u1, v1};
   tex2_t c_uv = {u2, v2};
 
+  // Pick one mip level for the whole triangle by comparing its area in UV space with its area on
+  // the screen, so minified triangles read from a smaller (and more cache friendly) level.
+  float screen_area = fabs((float)(x1 - x0) * (y2 - y0) - (float)(x2 - x0) * (y1 - y0));
+  float uv_area = fabs((u1 - u0) * (v2 - v0) - (u2 - u0) * (v1 - v0));
+  float lod = texture_lod(texture, context->settings.texture_filter, screen_area, uv_area);
+
+  touch_framebuffer(context, min3(x0, x1, x2), y0, max3(x0, x1, x2), y2);
+
   ///////////////////////////////////////////////////////
   // Render the upper part of the triangle (flat-bottom)
   ///////////////////////////////////////////////////////
@@ -306,16 +346,17 @@ void draw_textured_triangle(int x0, int y0, float z0, float w0, float u0, float
     inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
 
   if (y1 - y0 != 0) {
-    for (int y = y0; y <= y1; y++) {
+    for (int y = first_row(y0); y <= last_row(context, y1); y++) {
       int x_start = x1 + (y - y1) * inv_slope_1;
       int x_end = x0 + (y - y0) * inv_slope_2;
 
       if (x_end < x_start)
         int_swap(&x_start, &x_end); // swap if x_start is to the right of x_end
+      clip_span(context, &x_start, &x_end);
 
       for (int x = x_start; x < x_end; x++) {
         // Draw our pixel with the color that comes from the texture
-        draw_texel(x, y, texture, point_a, point_b, point_c, a_uv, b_uv, c_uv);
+        draw_texel(context, x, y, texture, lod, point_a, point_b, point_c, a_uv, b_uv, c_uv);
       }
     }
   }
@@ -332,16 +373,17 @@ void draw_textured_triangle(int x0, int y0, float z0, float w0, float u0, float
     inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
 
   if (y2 - y1 != 0) {
-    for (int y = y1; y <= y2; y++) {
+    for (int y = first_row(y1); y <= last_row(context, y2); y++) {
       int x_start = x1 + (y - y1) * inv_slope_1;
       int x_end = x0 + (y - y0) * inv_slope_2;
 
       if (x_end < x_start)
         int_swap(&x_start, &x_end); // swap if x_start is to the right of x_end
+      clip_span(context, &x_start, &x_end);
 
       for (int x = x_start; x < x_end; x++) {
         // Draw our pixel with the color that comes from the texture
-        draw_texel(x, y, texture, point_a, point_b, point_c, a_uv, b_uv, c_uv);
+        draw_texel(context, x, y, texture, lod, point_a, point_b, point_c, a_uv, b_uv, c_uv);
       }
     }
   }
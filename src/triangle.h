@@ -2,6 +2,7 @@
 #define TRIANGLE_H
 
 #include "display.h"
+#include "settings.h"
 #include "texture.h"
 #include "vector.h"
 
@@ -17,12 +18,44 @@ typedef struct {
   vec4_t points[3];
   tex2_t texcoords[3];
   color_t color;
+  texture_t *texture;
 } triangle_t;
 
-void draw_triangle(int x0, int y0, int x1, int y1, int x2, int y2, color_t color);
-void draw_filled_triangle(int x0, int y0, float z0, float w0, int x1, int y1, float z1, float w1,
-                          int x2, int y2, float z2, float w2, color_t color);
-void draw_textured_triangle(int x0, int y0, float z0, float w0, float u0, float v0, int x1, int y1,
-                            float z1, float w1, float u1, float v1, int x2, int y2, float z2,
-                            float w2, float u2, float v2, color_t *texture);
+////////////////////////////////////////////////////////////////////////////////
+// The projected triangles of one frame, plus the settings they were built
+// with, so the geometry stage never reads settings the input code is changing.
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+  triangle_t *triangles;
+  int capacity; // sized by pipeline_init() for every face of the scene
+  int num_triangles;
+  int num_faces;          // faces the meshes submitted, including the culled ones
+  int num_culled;         // faces rejected by backface culling
+  int num_frustum_culled; // faces entirely outside one of the frustum planes
+  int num_dropped;        // faces that didn't fit in the list
+  int frame; // counts the lists handed to the geometry stage, starting at 0
+  enum cull_method cull_method;
+  bool front_to_back; // sort the triangles nearest first once projected
+  int viewport_width; // render size the triangles are projected for
+  int viewport_height;
+  triangle_t *sorted; // scratch for the sort, which swaps it with triangles
+  float *sort_keys;
+} triangle_list_t;
+
+vec3_t barycentric_weights(vec2_t a, vec2_t b, vec2_t c, vec2_t p);
+void draw_triangle_pixel(render_context_t *context, int x, int y, color_t color, vec4_t point_a,
+                         vec4_t point_b, vec4_t point_c);
+void draw_texel(render_context_t *context, int x, int y, texture_t *texture, float lod,
+                vec4_t point_a, vec4_t point_b, vec4_t point_c, tex2_t a_uv, tex2_t b_uv,
+                tex2_t c_uv);
+
+void draw_triangle(render_context_t *context, int x0, int y0, int x1, int y1, int x2, int y2,
+                   color_t color);
+void draw_filled_triangle(render_context_t *context, int x0, int y0, float z0, float w0, int x1,
+                          int y1, float z1, float w1, int x2, int y2, float z2, float w2,
+                          color_t color);
+void draw_textured_triangle(render_context_t *context, int x0, int y0, float z0, float w0,
+                            float u0, float v0, int x1, int y1, float z1, float w1, float u1,
+                            float v1, int x2, int y2, float z2, float w2, float u2, float v2,
+                            texture_t *texture);
 #endif
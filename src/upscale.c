@@ -0,0 +1,156 @@
+#include "upscale.h"
+#include "memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static void build_columns(upscaler_t *upscaler, int src_width, int dst_width,
+                          enum upscale_filter filter) {
+  if (upscaler->column_x != NULL && upscaler->src_width == src_width &&
+      upscaler->dst_width == dst_width && upscaler->filter == filter) {
+    return;
+  }
+  free_upscaler(upscaler);
+  int *column_x = (int *)memory_alloc(MEMORY_SCRATCH, sizeof(int) * dst_width);
+  uint32_t *column_fx = (uint32_t *)memory_alloc(MEMORY_SCRATCH, sizeof(uint32_t) * dst_width);
+  upscaler->column_x = column_x;
+  upscaler->column_fx = column_fx;
+  upscaler->blended_row =
+      (color_t *)memory_alloc(MEMORY_SCRATCH, sizeof(color_t) * (src_width + 1));
+  upscaler->src_width = src_width;
+  upscaler->dst_width = dst_width;
+  upscaler->filter = filter;
+
+  if (filter == UPSCALE_NEAREST) {
+    for (int x = 0; x < dst_width; x++) {
+      column_x[x] = (int)((long)x * src_width / dst_width);
+      column_fx[x] = 0;
+    }
+    return;
+  }
+
+  for (int x = 0; x < dst_width; x++) {
+    // Sample at pixel centers, in 16.16 fixed point.
+    long fixed = ((2L * x + 1) * src_width * 65536L) / (2L * dst_width) - 32768;
+    if (fixed < 0) {
+      fixed = 0;
+    }
+    column_x[x] = (int)(fixed >> 16);
+    column_fx[x] = (uint32_t)((fixed & 0xFFFF) >> 8);
+    if (column_x[x] >= src_width - 1) {
+      column_x[x] = src_width - 1;
+      column_fx[x] = 0;
+    }
+  }
+}
+
+static void upscale_nearest(const upscaler_t *upscaler, const color_t *src, int src_width,
+                            int src_height, int src_stride, color_t *dst, int dst_width,
+                            int dst_height, int dst_stride) {
+  const int *column_x = upscaler->column_x;
+  int previous_y = -1;
+  for (int y = 0; y < dst_height; y++) {
+    int src_y = (int)((long)y * src_height / dst_height);
+    color_t *dst_row = &dst[dst_stride * y];
+
+    // Consecutive output rows from the same source row are plain copies.
+    if (src_y == previous_y) {
+      memcpy(dst_row, dst_row - dst_stride, sizeof(color_t) * dst_width);
+      continue;
+    }
+    const color_t *src_row = &src[src_stride * src_y];
+    for (int x = 0; x < dst_width; x++) {
+      dst_row[x] = src_row[column_x[x]];
+    }
+    previous_y = src_y;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Blend two source rows with the same weight for every pixel into
+// blended_row. With SSE2 four pixels are done at a time, widening each
+// channel to 16 bits.
+///////////////////////////////////////////////////////////////////////////////
+static void blend_rows(color_t *blended_row, const color_t *row0, const color_t *row1,
+                       uint32_t fy, int width) {
+  int x = 0;
+#ifdef __SSE2__
+  __m128i zero = _mm_setzero_si128();
+  __m128i w1 = _mm_set1_epi16((short)fy);
+  __m128i w0 = _mm_set1_epi16((short)(256 - fy));
+  for (; x + 4 <= width; x += 4) {
+    __m128i a = _mm_loadu_si128((const __m128i *)&row0[x]);
+    __m128i b = _mm_loadu_si128((const __m128i *)&row1[x]);
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), w0),
+                               _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w1));
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), w0),
+                               _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w1));
+    __m128i packed = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+    _mm_storeu_si128((__m128i *)&blended_row[x], packed);
+  }
+#endif
+  for (; x < width; x++) {
+    color_t a = row0[x];
+    color_t b = row1[x];
+    uint32_t rb = ((a & 0x00FF00FF) * (256 - fy) + (b & 0x00FF00FF) * fy) >> 8;
+    uint32_t ag = (((a >> 8) & 0x00FF00FF) * (256 - fy) + ((b >> 8) & 0x00FF00FF) * fy) >> 8;
+    blended_row[x] = (rb & 0x00FF00FF) | ((ag & 0x00FF00FF) << 8);
+  }
+}
+
+static void upscale_bilinear(const upscaler_t *upscaler, const color_t *src, int src_width,
+                             int src_height, int src_stride, color_t *dst, int dst_width,
+                             int dst_height, int dst_stride) {
+  const int *column_x = upscaler->column_x;
+  const uint32_t *column_fx = upscaler->column_fx;
+  color_t *blended_row = upscaler->blended_row;
+  for (int y = 0; y < dst_height; y++) {
+    long fixed = ((2L * y + 1) * src_height * 65536L) / (2L * dst_height) - 32768;
+    if (fixed < 0) {
+      fixed = 0;
+    }
+    int y0 = (int)(fixed >> 16);
+    int y1 = y0 + 1 < src_height ? y0 + 1 : y0;
+    uint32_t fy = (uint32_t)((fixed & 0xFFFF) >> 8);
+
+    blend_rows(blended_row, &src[src_stride * y0], &src[src_stride * y1], fy, src_width);
+    blended_row[src_width] = blended_row[src_width - 1];
+
+    color_t *dst_row = &dst[dst_stride * y];
+    for (int x = 0; x < dst_width; x++) {
+      color_t a = blended_row[column_x[x]];
+      color_t b = blended_row[column_x[x] + 1];
+      uint32_t fx = column_fx[x];
+      uint32_t rb = ((a & 0x00FF00FF) * (256 - fx) + (b & 0x00FF00FF) * fx) >> 8;
+      uint32_t ag = (((a >> 8) & 0x00FF00FF) * (256 - fx) + ((b >> 8) & 0x00FF00FF) * fx) >> 8;
+      dst_row[x] = (rb & 0x00FF00FF) | ((ag & 0x00FF00FF) << 8);
+    }
+  }
+}
+
+void upscale(upscaler_t *upscaler, const color_t *src, int src_width, int src_height,
+             int src_stride, color_t *dst, int dst_width, int dst_height, int dst_stride,
+             enum upscale_filter filter) {
+  build_columns(upscaler, src_width, dst_width, filter);
+
+  if (filter == UPSCALE_BILINEAR) {
+    upscale_bilinear(upscaler, src, src_width, src_height, src_stride, dst, dst_width, dst_height,
+                     dst_stride);
+  } else {
+    upscale_nearest(upscaler, src, src_width, src_height, src_stride, dst, dst_width, dst_height,
+                    dst_stride);
+  }
+}
+
+void free_upscaler(upscaler_t *upscaler) {
+  memory_free(upscaler->column_x);
+  memory_free(upscaler->column_fx);
+  memory_free(upscaler->blended_row);
+  upscaler->column_x = NULL;
+  upscaler->column_fx = NULL;
+  upscaler->blended_row = NULL;
+}
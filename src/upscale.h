@@ -0,0 +1,27 @@
+#ifndef UPSCALE_H
+#define UPSCALE_H
+
+#include "display.h"
+#include "settings.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Stretch a frame rendered at the render resolution to the output resolution.
+// Strides are in pixels.
+////////////////////////////////////////////////////////////////////////////////
+
+// Per-column lookups, rebuilt only when the sizes or the filter change.
+typedef struct {
+  int *column_x;        // source column of every destination column
+  uint32_t *column_fx;  // bilinear weight of the column to the right, 0..256
+  color_t *blended_row; // vertically blended source row (bilinear)
+  int src_width;
+  int dst_width;
+  enum upscale_filter filter;
+} upscaler_t;
+
+void upscale(upscaler_t *upscaler, const color_t *src, int src_width, int src_height,
+             int src_stride, color_t *dst, int dst_width, int dst_height, int dst_stride,
+             enum upscale_filter filter);
+void free_upscaler(upscaler_t *upscaler);
+
+#endif
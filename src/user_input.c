@@ -1,11 +1,13 @@
 #include "user_input.h"
-#include "settings.h"
+#include "context.h"
+#include "profiler.h"
 #include "state.h"
 
 #include <SDL2/SDL.h>
 #include <stdbool.h>
 
-void process_input(void) {
+void process_input(render_context_t *context) {
+  render_settings_t *settings = &context->settings;
   SDL_Event event;
   SDL_PollEvent(&event);
 
@@ -19,28 +21,67 @@ void process_input(void) {
       is_running = false;
       break;
     case SDLK_1:
-      render_method = RENDER_WIRE_VERTEX;
+      settings->render_method = RENDER_WIRE_VERTEX;
       break;
     case SDLK_2:
-      render_method = RENDER_WIRE;
+      settings->render_method = RENDER_WIRE;
       break;
     case SDLK_3:
-      render_method = RENDER_FILL_TRIANGLE;
+      settings->render_method = RENDER_FILL_TRIANGLE;
       break;
     case SDLK_4:
-      render_method = RENDER_FILL_TRIANGLE_WIRE;
+      settings->render_method = RENDER_FILL_TRIANGLE_WIRE;
       break;
     case SDLK_5:
-      render_method = RENDER_TEXTURED;
+      settings->render_method = RENDER_TEXTURED;
       break;
     case SDLK_6:
-      render_method = RENDER_TEXTURED_WIRE;
+      settings->render_method = RENDER_TEXTURED_WIRE;
+      break;
+    case SDLK_7:
+      settings->render_method = RENDER_OVERDRAW;
       break;
     case SDLK_c:
-      cull_method = CULL_NONE;
+      settings->cull_method = CULL_NONE;
       break;
     case SDLK_d:
-      cull_method = CULL_BACKFACE;
+      settings->cull_method = CULL_BACKFACE;
+      break;
+    case SDLK_n:
+      settings->texture_filter = FILTER_NEAREST;
+      break;
+    case SDLK_m:
+      settings->texture_filter = FILTER_MIPMAP;
+      break;
+    case SDLK_t:
+      settings->texture_filter = FILTER_TRILINEAR;
+      break;
+    case SDLK_p:
+      settings->frame_pipelining = !settings->frame_pipelining;
+      break;
+    case SDLK_o:
+      settings->front_to_back = !settings->front_to_back;
+      break;
+    case SDLK_MINUS:
+      settings->render_scale = settings->render_scale > 0.35 ? settings->render_scale - 0.1 : 0.25;
+      break;
+    case SDLK_EQUALS:
+      settings->render_scale = settings->render_scale < 0.9 ? settings->render_scale + 0.1 : 1.0;
+      break;
+    case SDLK_r:
+      settings->dynamic_resolution = !settings->dynamic_resolution;
+      break;
+    case SDLK_v:
+      pacing_mode = (pacing_mode + 1) % 3;
+      break;
+    case SDLK_h:
+      // The overlay shows the profiler's numbers, so it turns profiling on.
+      profiler_hud = !profiler_hud;
+      profiling = profiling || profiler_hud;
+      break;
+    case SDLK_b:
+      settings->upscale_filter =
+          settings->upscale_filter == UPSCALE_BILINEAR ? UPSCALE_NEAREST : UPSCALE_BILINEAR;
       break;
     }
     break;
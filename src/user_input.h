@@ -1,6 +1,8 @@
 #ifndef USER_INPUT_H
 #define USER_INPUT_H
 
-void process_input(void);
+#include "display.h"
+
+void process_input(render_context_t *context);
 
 #endif
@@ -0,0 +1,176 @@
+#include "video_output.h"
+#include "image.h"
+#include "memory.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VIDEO_OUTPUT_FILE_BUFFER (1 << 20)
+
+static FILE *file = NULL;
+static enum video_format format;
+static int frame_width = 0;
+static int frame_height = 0;
+
+// Frames waiting for the writer. The renderer fills ring[head], the writer drains ring[tail].
+static color_t *ring[VIDEO_OUTPUT_RING_SIZE];
+static int head = 0;
+static int tail = 0;
+static int count = 0;
+static bool closing = false;
+
+// Converted frame, only touched by the writer thread.
+static uint8_t *encoded = NULL;
+static size_t encoded_size = 0;
+
+static pthread_t writer_thread;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+///////////////////////////////////////////////////////////////////////////////
+// Full range BT.601 in 16.16 fixed point. Luma is computed per pixel, chroma
+// from the average of each 2x2 block (edge pixels repeat on odd sizes).
+///////////////////////////////////////////////////////////////////////////////
+static void encode_y4m(const color_t *pixels) {
+  int chroma_width = (frame_width + 1) / 2;
+  int chroma_height = (frame_height + 1) / 2;
+
+  memcpy(encoded, "FRAME\n", 6);
+  uint8_t *y_plane = encoded + 6;
+  uint8_t *u_plane = y_plane + frame_width * frame_height;
+  uint8_t *v_plane = u_plane + chroma_width * chroma_height;
+
+  for (int i = 0; i < frame_width * frame_height; i++) {
+    color_t c = pixels[i];
+    y_plane[i] = (19595 * color_red(c) + 38470 * color_green(c) + 7471 * color_blue(c) + 32768) >>
+                 16;
+  }
+
+  for (int cy = 0; cy < chroma_height; cy++) {
+    const color_t *row0 = &pixels[frame_width * (cy * 2)];
+    const color_t *row1 = cy * 2 + 1 < frame_height ? row0 + frame_width : row0;
+    for (int cx = 0; cx < chroma_width; cx++) {
+      int x0 = cx * 2;
+      int x1 = x0 + 1 < frame_width ? x0 + 1 : x0;
+      color_t c00 = row0[x0], c01 = row0[x1], c10 = row1[x0], c11 = row1[x1];
+      int r = color_red(c00) + color_red(c01) + color_red(c10) + color_red(c11);
+      int g = color_green(c00) + color_green(c01) + color_green(c10) + color_green(c11);
+      int b = color_blue(c00) + color_blue(c01) + color_blue(c10) + color_blue(c11);
+
+      // The sums are 4x the average, fold the division into the shift.
+      int u = (-11059 * r - 21709 * g + 32768 * b + (128 << 18) + (1 << 17)) >> 18;
+      int v = (32768 * r - 27439 * g - 5329 * b + (128 << 18) + (1 << 17)) >> 18;
+      u_plane[chroma_width * cy + cx] = u < 0 ? 0 : (u > 255 ? 255 : u);
+      v_plane[chroma_width * cy + cx] = v < 0 ? 0 : (v > 255 ? 255 : v);
+    }
+  }
+  encoded_size = (v_plane + chroma_width * chroma_height) - encoded;
+}
+
+static void *writer(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&mutex);
+  while (true) {
+    while (count == 0 && !closing) {
+      pthread_cond_wait(&cond, &mutex);
+    }
+    if (count == 0) {
+      break;
+    }
+    const color_t *pixels = ring[tail];
+    pthread_mutex_unlock(&mutex);
+
+    // The tail slot belongs to this thread until count goes down.
+    if (format == VIDEO_FORMAT_Y4M) {
+      encode_y4m(pixels);
+    } else {
+      encoded_size = encode_ppm(encoded, pixels, frame_width, frame_height, frame_width);
+    }
+    fwrite(encoded, 1, encoded_size, file);
+
+    pthread_mutex_lock(&mutex);
+    tail = (tail + 1) % VIDEO_OUTPUT_RING_SIZE;
+    count--;
+    pthread_cond_broadcast(&cond);
+  }
+  pthread_mutex_unlock(&mutex);
+  fflush(file);
+  return NULL;
+}
+
+bool video_output_open(const char *path, enum video_format video_format, int width, int height,
+                       int fps) {
+  file = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+  if (file == NULL) {
+    fprintf(stderr, "Error opening video output %s.\n", path);
+    return false;
+  }
+  setvbuf(file, NULL, _IOFBF, VIDEO_OUTPUT_FILE_BUFFER);
+
+  format = video_format;
+  frame_width = width;
+  frame_height = height;
+  for (int i = 0; i < VIDEO_OUTPUT_RING_SIZE; i++) {
+    ring[i] = (color_t *)memory_alloc(MEMORY_FRAME, sizeof(color_t) * width * height);
+  }
+  // A PPM is bigger than a 4:2:0 frame, so this fits either format.
+  encoded = (uint8_t *)memory_alloc(MEMORY_SCRATCH, ppm_size(width, height));
+
+  if (format == VIDEO_FORMAT_Y4M) {
+    fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n", width, height,
+            fps);
+  }
+
+  head = tail = count = 0;
+  closing = false;
+  pthread_create(&writer_thread, NULL, writer, NULL);
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Queue a frame_width x frame_height frame. Only waits when the writer is a
+// whole ring behind.
+///////////////////////////////////////////////////////////////////////////////
+void video_output_frame(const color_t *pixels, int stride) {
+  pthread_mutex_lock(&mutex);
+  while (count == VIDEO_OUTPUT_RING_SIZE) {
+    pthread_cond_wait(&cond, &mutex);
+  }
+  color_t *slot = ring[head];
+  pthread_mutex_unlock(&mutex);
+
+  for (int y = 0; y < frame_height; y++) {
+    memcpy(&slot[frame_width * y], &pixels[stride * y], sizeof(color_t) * frame_width);
+  }
+
+  pthread_mutex_lock(&mutex);
+  head = (head + 1) % VIDEO_OUTPUT_RING_SIZE;
+  count++;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&mutex);
+}
+
+void video_output_close(void) {
+  if (file == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&mutex);
+  closing = true;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&mutex);
+  pthread_join(writer_thread, NULL);
+
+  if (file != stdout) {
+    fclose(file);
+  }
+  file = NULL;
+  for (int i = 0; i < VIDEO_OUTPUT_RING_SIZE; i++) {
+    memory_free(ring[i]);
+  }
+  memory_free(encoded);
+}
+
+bool video_output_active(void) { return file != NULL; }
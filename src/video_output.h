@@ -0,0 +1,31 @@
+#ifndef VIDEO_OUTPUT_H
+#define VIDEO_OUTPUT_H
+
+#include "display.h"
+
+#include <stdbool.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Streams the presented frames to a file or pipe, for an external encoder.
+// Frames are copied into a small ring and converted and written by a
+// dedicated thread, so slow I/O only stalls the renderer once the whole ring
+// is full.
+////////////////////////////////////////////////////////////////////////////////
+
+#define VIDEO_OUTPUT_RING_SIZE 4
+
+enum video_format {
+  VIDEO_FORMAT_Y4M, // YUV4MPEG2, 4:2:0 full range BT.601
+  VIDEO_FORMAT_PPM  // concatenated binary P6 images
+};
+
+// Start streaming width x height frames to path, "-" being stdout.
+bool video_output_open(const char *path, enum video_format format, int width, int height,
+                       int fps);
+void video_output_frame(const color_t *pixels, int stride);
+// Write out the frames still in the ring and stop the writer.
+void video_output_close(void);
+
+bool video_output_active(void);
+
+#endif
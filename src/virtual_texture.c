@@ -0,0 +1,397 @@
+// mmap() and friends are POSIX, not C99.
+#define _POSIX_C_SOURCE 200809L
+
+#include "virtual_texture.h"
+#include "memory.h"
+#include "profiler.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int log2_int(int n) {
+  int shift = 0;
+  while ((1 << shift) < n) {
+    shift++;
+  }
+  return shift;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Decode a PNG, build its mip chain and write every level as a grid of tiles.
+// Edge tiles are padded with zeros; the sampler never reads the padding since
+// coordinates are wrapped to the level size first.
+///////////////////////////////////////////////////////////////////////////////
+bool virtual_texture_bake(const char *png_filename, const char *vtex_filename) {
+  upng_t *png = upng_new_from_file(png_filename);
+  if (png == NULL || upng_decode(png) != UPNG_EOK) {
+    fprintf(stderr, "Error decoding %s.\n", png_filename);
+    upng_free(png);
+    return false;
+  }
+  memory_track(MEMORY_SCRATCH, upng_get_size(png));
+
+  texture_t texture;
+  texture_init(&texture, upng_get_width(png), upng_get_height(png),
+               (color_t *)upng_get_buffer(png));
+  generate_mipmaps(&texture);
+
+  int tile_size = VIRTUAL_TEXTURE_TILE_SIZE;
+  virtual_texture_header_t header;
+  memset(&header, 0, sizeof(header));
+  header.magic = VIRTUAL_TEXTURE_MAGIC;
+  header.version = VIRTUAL_TEXTURE_VERSION;
+  header.tile_size = tile_size;
+  header.num_levels = texture.num_levels;
+
+  uint64_t offset = sizeof(header);
+  for (int i = 0; i < texture.num_levels; i++) {
+    header.levels[i].width = texture.levels[i].width;
+    header.levels[i].height = texture.levels[i].height;
+    header.levels[i].tiles_x = (texture.levels[i].width + tile_size - 1) / tile_size;
+    header.levels[i].tiles_y = (texture.levels[i].height + tile_size - 1) / tile_size;
+    header.levels[i].offset = offset;
+    offset += (uint64_t)header.levels[i].tiles_x * header.levels[i].tiles_y * tile_size *
+              tile_size * sizeof(color_t);
+  }
+
+  FILE *file = fopen(vtex_filename, "wb");
+  if (file == NULL) {
+    fprintf(stderr, "Error creating %s.\n", vtex_filename);
+    free_texture(&texture);
+    memory_track(MEMORY_SCRATCH, -(int64_t)upng_get_size(png));
+    upng_free(png);
+    return false;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+  color_t *tile = (color_t *)memory_alloc(MEMORY_SCRATCH, sizeof(color_t) * tile_size * tile_size);
+  for (int i = 0; ok && i < texture.num_levels; i++) {
+    mipmap_t *mipmap = &texture.levels[i];
+    for (uint32_t ty = 0; ty < header.levels[i].tiles_y; ty++) {
+      for (uint32_t tx = 0; tx < header.levels[i].tiles_x; tx++) {
+        memset(tile, 0, sizeof(color_t) * tile_size * tile_size);
+        for (int y = 0; y < tile_size && ty * tile_size + y < (uint32_t)mipmap->height; y++) {
+          int src_x = tx * tile_size;
+          int src_y = ty * tile_size + y;
+          int count = mipmap->width - src_x < tile_size ? mipmap->width - src_x : tile_size;
+          memcpy(&tile[tile_size * y], &mipmap->texels[(mipmap->width * src_y) + src_x],
+                 sizeof(color_t) * count);
+        }
+        ok = ok && fwrite(tile, sizeof(color_t), tile_size * tile_size, file) ==
+                       (size_t)(tile_size * tile_size);
+      }
+    }
+  }
+  memory_free(tile);
+  ok = fclose(file) == 0 && ok;
+  if (!ok) {
+    fprintf(stderr, "Error writing %s.\n", vtex_filename);
+  }
+
+  free_texture(&texture);
+  memory_track(MEMORY_SCRATCH, -(int64_t)upng_get_size(png));
+  upng_free(png);
+  return ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Whether a mapped header describes tiles that are all inside the file, laid
+// out the way the sampler indexes them, so a truncated or corrupt .vtex is
+// rejected here instead of faulting on the loader thread later.
+///////////////////////////////////////////////////////////////////////////////
+static bool header_is_valid(const virtual_texture_header_t *header, size_t map_size) {
+  uint32_t tile_size = header->tile_size;
+  if (header->magic != VIRTUAL_TEXTURE_MAGIC || header->version != VIRTUAL_TEXTURE_VERSION ||
+      header->num_levels == 0 || header->num_levels > MAX_MIPMAP_LEVELS || tile_size == 0 ||
+      tile_size > 4096 || (tile_size & (tile_size - 1)) != 0) {
+    return false;
+  }
+  uint64_t tile_bytes = (uint64_t)tile_size * tile_size * sizeof(color_t);
+  uint64_t num_pages = 0;
+  for (uint32_t i = 0; i < header->num_levels; i++) {
+    uint32_t width = header->levels[i].width;
+    uint32_t height = header->levels[i].height;
+    uint64_t tiles_x = header->levels[i].tiles_x;
+    uint64_t tiles_y = header->levels[i].tiles_y;
+    uint64_t offset = header->levels[i].offset;
+    if (width == 0 || height == 0 || width > (1 << 24) || height > (1 << 24) ||
+        tiles_x != (width + tile_size - 1) / tile_size ||
+        tiles_y != (height + tile_size - 1) / tile_size || offset % sizeof(color_t) != 0 ||
+        offset < sizeof(virtual_texture_header_t) || offset > map_size ||
+        tiles_x * tiles_y > (map_size - offset) / tile_bytes) {
+      return false;
+    }
+    num_pages += tiles_x * tiles_y;
+  }
+  return num_pages <= INT32_MAX;
+}
+
+static void *loader_thread(void *arg) {
+  virtual_texture_t *vt = (virtual_texture_t *)arg;
+  int tile_texels = vt->tile_size * vt->tile_size;
+  profiler_thread_name("texture loader");
+
+  pthread_mutex_lock(&vt->mutex);
+  while (true) {
+    while (!vt->quit && vt->num_requests == 0) {
+      pthread_cond_wait(&vt->wake, &vt->mutex);
+    }
+    if (vt->quit) {
+      break;
+    }
+    virtual_texture_request_t request = vt->requests[vt->first_request];
+    vt->first_request = (vt->first_request + 1) % VIRTUAL_TEXTURE_MAX_REQUESTS;
+    vt->num_requests--;
+    pthread_mutex_unlock(&vt->mutex);
+    uint64_t start = profile_begin();
+
+    // Find the page in the file. This copy is where the page faults on the mapping happen, so
+    // they stall this thread instead of the rasterizer. The slot is not in the page table while
+    // it is loading, so nobody reads it.
+    int level = vt->num_levels - 1;
+    while (request.page < vt->levels[level].first_page) {
+      level--;
+    }
+    int tile = request.page - vt->levels[level].first_page;
+    const color_t *src = vt->levels[level].tiles + (size_t)tile * tile_texels;
+    memcpy(&vt->slots[(size_t)request.slot * tile_texels], src, sizeof(color_t) * tile_texels);
+    profile_end(PROFILE_TEXTURE_LOAD, start);
+
+    pthread_mutex_lock(&vt->mutex);
+    vt->completed[vt->num_completed++] = request;
+  }
+  pthread_mutex_unlock(&vt->mutex);
+  return NULL;
+}
+
+virtual_texture_t *virtual_texture_open(const char *filename, int num_slots) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Error opening %s.\n", filename);
+    return NULL;
+  }
+
+  struct stat st;
+  void *map = NULL;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(virtual_texture_header_t)) {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  virtual_texture_header_t *header = (virtual_texture_header_t *)map;
+  if (map == NULL || map == MAP_FAILED || !header_is_valid(header, st.st_size)) {
+    fprintf(stderr, "Error reading virtual texture %s.\n", filename);
+    if (map != NULL && map != MAP_FAILED) {
+      munmap(map, st.st_size);
+    }
+    close(fd);
+    return NULL;
+  }
+
+  virtual_texture_t *vt =
+      (virtual_texture_t *)memory_calloc(MEMORY_TEXTURE, 1, sizeof(virtual_texture_t));
+  vt->fd = fd;
+  vt->map = map;
+  vt->map_size = st.st_size;
+  vt->tile_size = header->tile_size;
+  vt->tile_shift = log2_int(header->tile_size);
+  vt->num_levels = header->num_levels;
+
+  int num_pinned = 0;
+  for (int i = 0; i < vt->num_levels; i++) {
+    virtual_texture_level_t *level = &vt->levels[i];
+    level->width = header->levels[i].width;
+    level->height = header->levels[i].height;
+    level->tiles_x = header->levels[i].tiles_x;
+    level->tiles_y = header->levels[i].tiles_y;
+    level->first_page = vt->num_pages;
+    level->tiles = (const color_t *)((const uint8_t *)map + header->levels[i].offset);
+    vt->num_pages += level->tiles_x * level->tiles_y;
+    if (level->tiles_x * level->tiles_y == 1) {
+      num_pinned++;
+    }
+  }
+
+  // Leave room for at least a few streamed pages next to the pinned ones.
+  if (num_slots < num_pinned + 4) {
+    num_slots = num_pinned + 4;
+  }
+  int tile_texels = vt->tile_size * vt->tile_size;
+  vt->num_slots = num_slots;
+  vt->slots = (color_t *)memory_alloc(MEMORY_TEXTURE, sizeof(color_t) * tile_texels * num_slots);
+  vt->slot_page = (int32_t *)memory_alloc(MEMORY_TEXTURE, sizeof(int32_t) * num_slots);
+  vt->slot_last_used = (uint32_t *)memory_calloc(MEMORY_TEXTURE, num_slots, sizeof(uint32_t));
+  vt->slot_pinned = (uint8_t *)memory_calloc(MEMORY_TEXTURE, num_slots, sizeof(uint8_t));
+  vt->page_table = (int32_t *)memory_alloc(MEMORY_TEXTURE, sizeof(int32_t) * vt->num_pages);
+  vt->feedback = (uint8_t *)memory_calloc(MEMORY_TEXTURE, vt->num_pages, sizeof(uint8_t));
+  vt->pending = (uint8_t *)memory_calloc(MEMORY_TEXTURE, vt->num_pages, sizeof(uint8_t));
+  for (int i = 0; i < num_slots; i++) {
+    vt->slot_page[i] = -1;
+  }
+  for (int i = 0; i < vt->num_pages; i++) {
+    vt->page_table[i] = -1;
+  }
+
+  // The single-tile levels are the fallback of last resort, load them now and keep them.
+  int slot = 0;
+  for (int i = 0; i < vt->num_levels; i++) {
+    virtual_texture_level_t *level = &vt->levels[i];
+    if (level->tiles_x * level->tiles_y == 1) {
+      memcpy(&vt->slots[(size_t)slot * tile_texels], level->tiles, sizeof(color_t) * tile_texels);
+      vt->page_table[level->first_page] = slot;
+      vt->slot_page[slot] = level->first_page;
+      vt->slot_pinned[slot] = 1;
+      slot++;
+    }
+  }
+
+  pthread_mutex_init(&vt->mutex, NULL);
+  pthread_cond_init(&vt->wake, NULL);
+  pthread_create(&vt->loader, NULL, loader_thread, vt);
+  return vt;
+}
+
+void virtual_texture_close(virtual_texture_t *vt) {
+  if (vt == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&vt->mutex);
+  vt->quit = true;
+  pthread_cond_signal(&vt->wake);
+  pthread_mutex_unlock(&vt->mutex);
+  pthread_join(vt->loader, NULL);
+  pthread_mutex_destroy(&vt->mutex);
+  pthread_cond_destroy(&vt->wake);
+
+  munmap(vt->map, vt->map_size);
+  close(vt->fd);
+  memory_free(vt->slots);
+  memory_free(vt->slot_page);
+  memory_free(vt->slot_last_used);
+  memory_free(vt->slot_pinned);
+  memory_free(vt->page_table);
+  memory_free(vt->feedback);
+  memory_free(vt->pending);
+  memory_free(vt);
+}
+
+// Least recently used slot that is not pinned, not loading and not sampled this frame.
+static int find_victim_slot(virtual_texture_t *vt) {
+  int victim = -1;
+  for (int i = 0; i < vt->num_slots; i++) {
+    if (vt->slot_pinned[i] || vt->slot_page[i] == -2) {
+      continue;
+    }
+    if (vt->slot_page[i] == -1) {
+      return i;
+    }
+    if (vt->slot_last_used[i] != vt->frame &&
+        (victim < 0 || vt->slot_last_used[i] < vt->slot_last_used[victim])) {
+      victim = i;
+    }
+  }
+  return victim;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Once per frame, after rasterization: publish the pages the loader finished,
+// then turn this frame's feedback into new requests. Coarse levels are
+// requested first so the fallback quality improves step by step.
+///////////////////////////////////////////////////////////////////////////////
+void virtual_texture_update(virtual_texture_t *vt) {
+  pthread_mutex_lock(&vt->mutex);
+  for (int i = 0; i < vt->num_completed; i++) {
+    virtual_texture_request_t request = vt->completed[i];
+    vt->page_table[request.page] = request.slot;
+    vt->slot_page[request.slot] = request.page;
+    vt->slot_last_used[request.slot] = vt->frame;
+    vt->pending[request.page] = 0;
+  }
+  vt->num_completed = 0;
+  pthread_mutex_unlock(&vt->mutex);
+
+  // Refresh the LRU timestamps first, so no page sampled this frame gets evicted below.
+  for (int page = 0; page < vt->num_pages; page++) {
+    if (vt->feedback[page] && vt->page_table[page] >= 0) {
+      vt->slot_last_used[vt->page_table[page]] = vt->frame;
+      vt->feedback[page] = 0;
+    }
+  }
+
+  virtual_texture_request_t requests[VIRTUAL_TEXTURE_MAX_REQUESTS];
+  int num_requests = 0;
+  for (int i = vt->num_levels - 1; i >= 0; i--) {
+    virtual_texture_level_t *level = &vt->levels[i];
+    int last_page = level->first_page + level->tiles_x * level->tiles_y;
+    for (int page = level->first_page; page < last_page; page++) {
+      if (!vt->feedback[page]) {
+        continue;
+      }
+      vt->feedback[page] = 0;
+      if (vt->pending[page] || num_requests == VIRTUAL_TEXTURE_MAX_REQUESTS) {
+        continue;
+      }
+
+      int slot = find_victim_slot(vt);
+      if (slot < 0) {
+        continue; // every slot is busy this frame, try again on the next one
+      }
+      if (vt->slot_page[slot] >= 0) {
+        vt->page_table[vt->slot_page[slot]] = -1;
+      }
+      vt->slot_page[slot] = -2;
+      vt->pending[page] = 1;
+      requests[num_requests++] = (virtual_texture_request_t){.page = page, .slot = slot};
+    }
+  }
+
+  if (num_requests > 0) {
+    pthread_mutex_lock(&vt->mutex);
+    for (int i = 0; i < num_requests; i++) {
+      if (vt->num_requests < VIRTUAL_TEXTURE_MAX_REQUESTS) {
+        int last = (vt->first_request + vt->num_requests) % VIRTUAL_TEXTURE_MAX_REQUESTS;
+        vt->requests[last] = requests[i];
+        vt->num_requests++;
+      } else {
+        // The loader is behind, hand the slot back and ask again later.
+        vt->slot_page[requests[i].slot] = -1;
+        vt->pending[requests[i].page] = 0;
+      }
+    }
+    pthread_cond_signal(&vt->wake);
+    pthread_mutex_unlock(&vt->mutex);
+  }
+
+  vt->frame++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sample (u, v) at the given level, walking down to coarser levels until a
+// resident page is found. Every page on the way is recorded as feedback.
+///////////////////////////////////////////////////////////////////////////////
+color_t virtual_texture_sample(virtual_texture_t *vt, int level, float u, float v) {
+  int tile_mask = vt->tile_size - 1;
+
+  for (; level < vt->num_levels; level++) {
+    virtual_texture_level_t *l = &vt->levels[level];
+
+    // Map the UV coordinate to the level width and height
+    // These mods at the end are hacks.
+    int tex_x = abs((int)(u * l->width)) % l->width;
+    int tex_y = abs((int)(v * l->height)) % l->height;
+
+    int page = l->first_page + (tex_y >> vt->tile_shift) * l->tiles_x + (tex_x >> vt->tile_shift);
+    vt->feedback[page] = 1;
+
+    int slot = vt->page_table[page];
+    if (slot >= 0) {
+      size_t texel = ((size_t)slot << (2 * vt->tile_shift)) +
+                     ((tex_y & tile_mask) << vt->tile_shift) + (tex_x & tile_mask);
+      return vt->slots[texel];
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,103 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include "texture.h"
+
+#include <pthread.h>
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Sparse virtual textures. A texture is baked once into a .vtex file that
+// holds every mip level cut into square tiles ("pages"). At runtime the file
+// is memory-mapped and only the pages the rasterizer actually touches are
+// copied into a fixed-size cache of resident slots, so texture memory stays
+// bounded no matter how big the source image is.
+//
+// Every sample records the page it wanted in a feedback buffer. Once per frame
+// virtual_texture_update() turns that feedback into load requests for a
+// background thread and publishes the pages that finished loading. Until a
+// page arrives the sampler falls back to the closest coarser level that is
+// resident; the coarsest levels are loaded up front and never evicted.
+////////////////////////////////////////////////////////////////////////////////
+
+#define VIRTUAL_TEXTURE_MAGIC 0x58455456 // "VTEX"
+#define VIRTUAL_TEXTURE_VERSION 1
+#define VIRTUAL_TEXTURE_TILE_SIZE 128
+#define VIRTUAL_TEXTURE_CACHE_SLOTS 256
+#define VIRTUAL_TEXTURE_MAX_REQUESTS 32 // new page requests per frame
+
+// On-disk header, followed by the tiles of every level in order.
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t tile_size;
+  uint32_t num_levels;
+  struct {
+    uint32_t width;
+    uint32_t height;
+    uint32_t tiles_x;
+    uint32_t tiles_y;
+    uint64_t offset; // file offset of the first tile of the level
+  } levels[MAX_MIPMAP_LEVELS];
+} virtual_texture_header_t;
+
+typedef struct {
+  int width;
+  int height;
+  int tiles_x;
+  int tiles_y;
+  int first_page; // index of the level's first page in the page table
+  const color_t *tiles;
+} virtual_texture_level_t;
+
+typedef struct {
+  int page;
+  int slot;
+} virtual_texture_request_t;
+
+typedef struct virtual_texture {
+  // Memory-mapped .vtex file
+  int fd;
+  void *map;
+  size_t map_size;
+
+  int tile_size;
+  int tile_shift;
+  int num_levels;
+  virtual_texture_level_t levels[MAX_MIPMAP_LEVELS];
+
+  // One entry per page: the cache slot holding it, or -1 when not resident.
+  int num_pages;
+  int32_t *page_table;
+  uint8_t *feedback; // pages sampled during the current frame
+  uint8_t *pending;  // pages handed to the loader thread
+
+  // Resident page cache
+  int num_slots;
+  color_t *slots;
+  int32_t *slot_page;
+  uint32_t *slot_last_used;
+  uint8_t *slot_pinned;
+  uint32_t frame;
+
+  // Loader thread and the queues it shares with the render thread
+  pthread_t loader;
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;
+  bool quit;
+  int first_request; // requests are a ring, loaded in the order they were made
+  int num_requests;
+  virtual_texture_request_t requests[VIRTUAL_TEXTURE_MAX_REQUESTS];
+  int num_completed;
+  virtual_texture_request_t completed[VIRTUAL_TEXTURE_CACHE_SLOTS];
+} virtual_texture_t;
+
+bool virtual_texture_bake(const char *png_filename, const char *vtex_filename);
+
+virtual_texture_t *virtual_texture_open(const char *filename, int num_slots);
+void virtual_texture_close(virtual_texture_t *vt);
+
+void virtual_texture_update(virtual_texture_t *vt);
+color_t virtual_texture_sample(virtual_texture_t *vt, int level, float u, float v);
+
+#endif